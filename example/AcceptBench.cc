@@ -0,0 +1,133 @@
+/**
+ * 短连接建立速率测试，对比两种accept方式：
+ *   baseLoop   baseLoop accept以后通过runInLoop把连接交给subLoop(默认)
+ *   perLoop    每个subLoop各自监听同一个端口(TcpServer::setAcceptPerLoop)，在本线程中建立连接
+ * 客户端在fork出的clients个子进程中循环：connect，发送1字节，等回显以及服务器关闭连接，持续seconds秒。
+ * 输出每秒建立的连接数以及baseLoop线程消耗的CPU时间
+ *
+ * 用法: ./AcceptBench [threads] [clients] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static double threadCpuSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 子进程：一个接一个地建立短连接，返回完成的连接数
+static long runClient(int seconds, uint16_t port)
+{
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    long connections = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            ::close(fd);
+            continue;
+        }
+        char c = 'c';
+        ::write(fd, &c, 1);
+        // 读到回显和服务器的FIN，TIME_WAIT留在服务器一端，客户端的临时端口不会耗尽
+        while (::read(fd, &c, 1) > 0)
+        {
+        }
+        ::close(fd);
+        ++connections;
+    }
+    return connections;
+}
+
+static void run(bool perLoop, int threads, int clients, int seconds, uint16_t port)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "AcceptBench");
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        conn->shutdown();
+    });
+    server.setThreadNum(threads);
+    server.setAcceptPerLoop(perLoop);
+    server.start();
+
+    int pipefd[2];
+    ::pipe(pipefd);
+    std::vector<pid_t> children;
+    for (int i = 0; i < clients; ++i)
+    {
+        pid_t child = ::fork();
+        if (child == 0)
+        {
+            long connections = runClient(seconds, port);
+            ::write(pipefd[1], &connections, sizeof(connections));
+            ::_exit(0);
+        }
+        children.push_back(child);
+    }
+
+    // 所有客户端结束以后退出loop
+    size_t exited = 0;
+    loop.runEvery(0.05, [&]() {
+        while (exited < children.size() && ::waitpid(children[exited], nullptr, WNOHANG) == children[exited])
+        {
+            ++exited;
+        }
+        if (exited == children.size())
+        {
+            loop.quit();
+        }
+    });
+    double cpu0 = threadCpuSeconds();
+    loop.loop();
+    double baseCpu = threadCpuSeconds() - cpu0;
+
+    long total = 0;
+    for (int i = 0; i < clients; ++i)
+    {
+        long connections = 0;
+        ::read(pipefd[0], &connections, sizeof(connections));
+        total += connections;
+    }
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    printf("%-9s threads=%d clients=%d  %8.0f conn/s  baseLoop cpu %.2fs\n",
+           perLoop ? "perLoop" : "baseLoop", threads, clients,
+           static_cast<double>(total) / seconds, baseCpu);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int threads = argc > 1 ? atoi(argv[1]) : 4;
+    int clients = argc > 2 ? atoi(argv[2]) : 8;
+    int seconds = argc > 3 ? atoi(argv[3]) : 3;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9600);
+
+    run(false, threads, clients, seconds, port);
+    run(true, threads, clients, seconds, port);
+    return 0;
+}
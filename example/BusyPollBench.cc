@@ -0,0 +1,118 @@
+/**
+ * ping-pong延迟测试，对比EventLoop的busy-poll和普通阻塞模式：
+ * 客户端发送64字节等待回显，两次请求之间间隔gapUs微秒，统计往返延迟的p50/p99以及服务器loop线程消耗的CPU时间
+ *
+ * 注意：客户端和服务器在同一台机器上，只有一个CPU核时自旋的loop线程会和客户端抢CPU，
+ * busy-poll的收益需要在多核(最好把loop线程绑到单独的核上)上观察
+ *
+ * 用法: ./BusyPollBench [rounds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static double threadCpuSeconds()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(const char *name, int maxSpinUs, int gapUs, int rounds, uint16_t port)
+{
+    EventLoop *serverLoop = nullptr;
+    double serverCpu = 0;
+    std::atomic<bool> ready(false);
+    std::thread server([&] {
+        EventLoop loop;
+        TcpServer echo(&loop, InetAddress(port), name);
+        echo.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+            conn->send(buf);
+        });
+        echo.setBusyPoll(maxSpinUs);
+        echo.start();
+        serverLoop = &loop;
+        ready = true;
+        double cpu0 = threadCpuSeconds();
+        loop.loop();
+        serverCpu = threadCpuSeconds() - cpu0;
+    });
+    while (!ready)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char msg[64];
+    ::memset(msg, 'p', sizeof(msg));
+    std::vector<double> latencies;
+    latencies.reserve(rounds);
+    for (int i = 0; i < rounds; ++i)
+    {
+        if (gapUs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        ::write(fd, msg, sizeof(msg));
+        size_t got = 0;
+        char buf[64];
+        while (got < sizeof(msg))
+        {
+            ssize_t n = ::read(fd, buf, sizeof(buf));
+            if (n <= 0) break;
+            got += n;
+        }
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+    }
+    ::close(fd);
+    serverLoop->quit();
+    server.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-12s gap=%4dus  p50 %7.1fus  p99 %7.1fus  server cpu %.2fs\n",
+           name, gapUs, latencies[latencies.size() / 2], latencies[latencies.size() * 99 / 100], serverCpu);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    uint16_t port = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 9300);
+
+    const int gaps[] = { 0, 100 };
+    for (int gap : gaps)
+    {
+        run("blocking", 0, gap, rounds, port);
+        run("spin-50us", 50, gap, rounds, port);
+        run("spin-200us", 200, gap, rounds, port);
+    }
+    return 0;
+}
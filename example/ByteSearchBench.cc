@@ -0,0 +1,97 @@
+/**
+ * 对比HTTP头部切分的两种实现：
+ * legacy: 旧的Buffer::findCRLF(std::search) + std::find(':')
+ * simd  : bytesearch::findCRLF + bytesearch::findChar (运行时选择AVX2/SSE2)
+ *
+ * 用法: ./ByteSearchBench [iterations]
+ */
+#include "ByteSearch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+static const char kCRLF[] = "\r\n";
+
+// 浏览器发出的一个典型请求头
+static const std::string kBrowserHeaders =
+    "GET /api/v1/items?id=12345&sort=desc HTTP/1.1\r\n"
+    "Host: www.example.com:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:102.0) Gecko/20100101 Firefox/102.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Referer: https://www.example.com/catalog/index.html?page=3\r\n"
+    "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark; tracking=abcdefghijklmnopqrstuvwxyz\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "\r\n";
+
+// wrk之类的压测工具发出的短请求头
+static const std::string kShortHeaders =
+    "GET /hello HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "\r\n";
+
+template <typename FindCRLF, typename FindColon>
+static size_t splitHeaders(const std::string &block, FindCRLF findCRLF, FindColon findColon)
+{
+    size_t colons = 0;
+    const char *p = block.data();
+    const char *end = block.data() + block.size();
+    while (p < end)
+    {
+        const char *crlf = findCRLF(p, end);
+        if (crlf == end) break;
+        if (findColon(p, crlf) != crlf) ++colons;
+        p = crlf + 2;
+    }
+    return colons;
+}
+
+template <typename Func>
+static double nsPerBlock(int iterations, Func func)
+{
+    volatile size_t sink = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        sink = sink + func();
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    return static_cast<double>(ns) / iterations;
+}
+
+static void bench(const char *name, const std::string &block, int iterations)
+{
+    double legacy = nsPerBlock(iterations, [&] {
+        return splitHeaders(block,
+            [](const char *b, const char *e) { return std::search(b, e, kCRLF, kCRLF + 2); },
+            [](const char *b, const char *e) { return std::find(b, e, ':'); });
+    });
+    double simd = nsPerBlock(iterations, [&] {
+        return splitHeaders(block,
+            [](const char *b, const char *e) { return bytesearch::findCRLF(b, e); },
+            [](const char *b, const char *e) { return bytesearch::findChar(b, e, ':'); });
+    });
+    printf("%-14s %5zu bytes  legacy %8.1f ns  %s %8.1f ns  speedup %.2fx\n",
+           name, block.size(), legacy, bytesearch::implementation(), simd, legacy / simd);
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    bench("short-headers", kShortHeaders, iterations);
+    bench("browser", kBrowserHeaders, iterations);
+
+    // 一个很长的头部（例如很大的Cookie），考察长行上的扫描速度
+    std::string longLine = "X-Long: " + std::string(8192, 'a') + "\r\n\r\n";
+    bench("8KB-line", longLine, iterations / 20);
+    return 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * 连接频繁建立、关闭时Poller中channel表的开销：
+ * 打开fds个eventfd，每一轮把它们全部注册到loop(enableReading)再全部注销(disableAll + remove)，
+ * 统计每次注册+注销的耗时(包括两次epoll_ctl)和堆内存分配次数。
+ * 另外单独对比channel表本身：std::unordered_map<int, Channel*>(之前的实现)和按fd下标的数组
+ *
+ * 用法: ./ChannelTableBench [fds] [rounds]
+ */
+#include "EventLoop.h"
+#include "Channel.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static size_t gAllocations = 0;
+
+void* operator new(size_t size)
+{
+    ++gAllocations;
+    void *p = ::malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { ::free(p); }
+void operator delete(void *p, size_t) noexcept { ::free(p); }
+
+static double nowNs()
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void benchPoller(int numFds, int rounds)
+{
+    EventLoop loop;
+    std::vector<int> fds;
+    std::vector<std::unique_ptr<Channel>> channels;
+    for (int i = 0; i < numFds; ++i)
+    {
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        fds.push_back(fd);
+        channels.emplace_back(new Channel(&loop, fd));
+    }
+
+    // 第一轮让表扩容到最大的fd，不计入结果
+    for (int r = 0; r <= rounds; ++r)
+    {
+        size_t allocations0 = gAllocations;
+        double t0 = nowNs();
+        for (auto &channel : channels)
+        {
+            channel->enableReading();
+        }
+        for (auto &channel : channels)
+        {
+            channel->disableAll();
+            channel->remove();
+        }
+        double elapsed = nowNs() - t0;
+        if (r == rounds)
+        {
+            printf("%-8s add+remove  %7.1f ns  %.3f allocations per channel\n", loop.pollerName(),
+                   elapsed / numFds, static_cast<double>(gAllocations - allocations0) / numFds);
+        }
+    }
+
+    channels.clear();
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+}
+
+// 只比较表本身：插入、查找、删除同一批fd
+static void benchTable(int numFds, int rounds)
+{
+    std::vector<Channel*> fake(numFds + 64, nullptr);
+    for (size_t i = 0; i < fake.size(); ++i)
+    {
+        fake[i] = reinterpret_cast<Channel*>(0x1000 + i * 64);
+    }
+
+    std::unordered_map<int, Channel*> map;
+    size_t allocations0 = gAllocations;
+    double t0 = nowNs();
+    size_t found = 0;
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int fd = 0; fd < numFds; ++fd) map[fd] = fake[fd];
+        for (int fd = 0; fd < numFds; ++fd) found += map.find(fd)->second == fake[fd];
+        for (int fd = 0; fd < numFds; ++fd) map.erase(fd);
+    }
+    double mapNs = (nowNs() - t0) / (static_cast<double>(numFds) * rounds);
+    double mapAllocs = static_cast<double>(gAllocations - allocations0) / (static_cast<double>(numFds) * rounds);
+
+    struct Slot
+    {
+        Channel *channel;
+        uint32_t gen;
+    };
+    std::vector<Slot> table(numFds, Slot{nullptr, 0});
+    allocations0 = gAllocations;
+    t0 = nowNs();
+    for (int r = 0; r < rounds; ++r)
+    {
+        for (int fd = 0; fd < numFds; ++fd) { table[fd].channel = fake[fd]; ++table[fd].gen; }
+        for (int fd = 0; fd < numFds; ++fd) found += table[fd].channel == fake[fd];
+        for (int fd = 0; fd < numFds; ++fd) table[fd].channel = nullptr;
+    }
+    double tableNs = (nowNs() - t0) / (static_cast<double>(numFds) * rounds);
+    double tableAllocs = static_cast<double>(gAllocations - allocations0) / (static_cast<double>(numFds) * rounds);
+
+    printf("table    unordered_map %6.1f ns %.3f allocations | flat array %6.1f ns %.3f allocations (per insert+find+erase, check %zu)\n",
+           mapNs, mapAllocs, tableNs, tableAllocs, found);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int numFds = argc > 1 ? atoi(argv[1]) : 10000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    benchPoller(numFds, rounds);
+    benchTable(numFds, rounds);
+    return 0;
+}
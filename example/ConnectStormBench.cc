@@ -0,0 +1,161 @@
+/**
+ * 连接风暴下的accept性能：客户端在fork出的子进程中每一轮同时发起burst个非阻塞connect，
+ * 每个连接建立后发送1字节，收到回显和服务器的FIN以后关闭，所有连接都结束后开始下一轮，持续seconds秒。
+ * 服务器用两个subLoop处理连接，baseLoop只做accept，对比：
+ *   accept x1      每次可读事件只accept一个连接(改动之前的行为)
+ *   accept x64     一次可读事件最多accept 64个连接
+ *   x64+defer      再加上TCP_DEFER_ACCEPT，连接上的数据到了才accept
+ * 输出每秒建立的连接数，以及baseLoop平均每个连接的epoll调用次数
+ *
+ * 用法: ./ConnectStormBench [burst] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+// 子进程：一轮一轮地发起burst个并发连接，返回完成的连接数
+static long runClient(int burst, int seconds, uint16_t port)
+{
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int epfd = ::epoll_create1(0);
+    std::vector<epoll_event> events(burst);
+    long connections = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int pending = 0;
+        for (int i = 0; i < burst; ++i)
+        {
+            int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 && errno != EINPROGRESS)
+            {
+                ::close(fd);
+                continue;
+            }
+            // 先等可写(连接建立)，发送1字节以后再等可读
+            epoll_event ev;
+            ev.events = EPOLLOUT;
+            ev.data.fd = fd;
+            ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+            ++pending;
+        }
+        while (pending > 0)
+        {
+            int n = ::epoll_wait(epfd, events.data(), burst, 1000);
+            if (n <= 0)
+            {
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                int fd = events[i].data.fd;
+                char buf[16];
+                if (events[i].events & EPOLLOUT)
+                {
+                    buf[0] = 'c';
+                    if (::write(fd, buf, 1) == 1)
+                    {
+                        epoll_event ev;
+                        ev.events = EPOLLIN;
+                        ev.data.fd = fd;
+                        ::epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+                        continue;
+                    }
+                }
+                else if (::read(fd, buf, sizeof(buf)) > 0)
+                {
+                    continue;   // 回显，接着等FIN
+                }
+                else
+                {
+                    ++connections;
+                }
+                ::close(fd);
+                --pending;
+            }
+        }
+    }
+    ::close(epfd);
+    return connections;
+}
+
+static void run(const char *name, int maxAccepts, int deferAccept, int burst, int seconds, uint16_t port)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), name);
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+        conn->shutdown();
+    });
+    server.setThreadNum(2);
+    server.setListenBacklog(4096);
+    server.setMaxAcceptsPerEvent(maxAccepts);
+    server.setDeferAccept(deferAccept);
+    server.start();
+
+    int pipefd[2];
+    ::pipe(pipefd);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        long connections = runClient(burst, seconds, port);
+        ::write(pipefd[1], &connections, sizeof(connections));
+        ::_exit(0);
+    }
+
+    uint64_t poller0 = loop.pollerSyscalls();
+    uint64_t pollerCalls = 0;
+    loop.runEvery(0.05, [&]() {
+        if (::waitpid(child, nullptr, WNOHANG) == child)
+        {
+            pollerCalls = loop.pollerSyscalls() - poller0;
+            loop.quit();
+        }
+    });
+    loop.loop();
+
+    long connections = 0;
+    ::read(pipefd[0], &connections, sizeof(connections));
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    if (connections <= 0)
+    {
+        printf("%-12s no connections completed\n", name);
+        return;
+    }
+    printf("%-12s burst=%4d  %8.0f conn/s  baseLoop epoll calls/conn %.3f\n",
+           name, burst, static_cast<double>(connections) / seconds,
+           static_cast<double>(pollerCalls) / connections);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int burst = argc > 1 ? atoi(argv[1]) : 256;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9700);
+
+    run("accept x1", 1, 0, burst, seconds, port);
+    run("accept x64", 64, 0, burst, seconds, port);
+    run("x64+defer", 64, 1, burst, seconds, port);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/**
+ * 对比水平触发和边沿触发(TcpServer::setEdgeTriggered)：
+ * 客户端在fork出的子进程中用conns个连接，每个连接发送8字节的请求，服务器回复replySize字节，收完回复再发下一个请求，持续seconds秒。
+ * 回复超过socket发送缓冲区时，水平触发每个回复都要注册、注销一次EPOLLOUT(两次epoll_ctl)，边沿触发不需要。
+ * 服务器进程统计每个请求平均的epoll调用次数(epoll_wait+epoll_ctl)和read/write类调用次数(/proc/self/io)
+ *
+ * 用法: ./EdgeTriggerBench [conns] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static const size_t kRequestSize = 8;
+
+// 本进程累计的read类和write类系统调用次数
+static long readWriteSyscalls()
+{
+    FILE *fp = ::fopen("/proc/self/io", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[128];
+    long value = 0;
+    long total = 0;
+    while (::fgets(line, sizeof(line), fp) != nullptr)
+    {
+        if (::sscanf(line, "syscr: %ld", &value) == 1 || ::sscanf(line, "syscw: %ld", &value) == 1)
+        {
+            total += value;
+        }
+    }
+    ::fclose(fp);
+    return total;
+}
+
+// 子进程：conns个连接并发请求，返回完成的请求数
+static long runClient(int conns, int seconds, size_t replySize, uint16_t port)
+{
+    int epfd = ::epoll_create1(0);
+    std::vector<int> fds;
+    std::vector<size_t> received(conns, 0);
+    char request[kRequestSize];
+    ::memset(request, 'q', sizeof(request));
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+        ::write(fd, request, sizeof(request));
+    }
+
+    long requests = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    epoll_event events[256];
+    std::vector<char> buf(256 * 1024);
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int n = ::epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            ssize_t r = ::read(fds[idx], buf.data(), buf.size());
+            if (r <= 0) continue;
+            received[idx] += r;
+            if (received[idx] >= replySize)
+            {
+                received[idx] = 0;
+                ++requests;
+                ::write(fds[idx], request, sizeof(request));
+            }
+        }
+    }
+    // 收完在路上的回复再关闭，避免服务器在RST上报错
+    for (int i = 0; i < conns; ++i)
+    {
+        while (received[i] < replySize)
+        {
+            ssize_t r = ::read(fds[i], buf.data(), buf.size());
+            if (r <= 0) break;
+            received[i] += r;
+        }
+        ::close(fds[i]);
+    }
+    return requests;
+}
+
+static void run(bool edgeTriggered, int conns, int seconds, size_t replySize, uint16_t port)
+{
+    int pipefd[2];
+    ::pipe(pipefd);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        long requests = runClient(conns, seconds, replySize, port);
+        ::write(pipefd[1], &requests, sizeof(requests));
+        ::_exit(0);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "EdgeTriggerBench");
+    PayloadPtr reply = makePayload(std::string(replySize, 'r'));
+    server.setMessageCallback([reply](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        while (buf->readableBytes() >= kRequestSize)
+        {
+            buf->retrieve(kRequestSize);
+            conn->send(reply);
+        }
+    });
+    server.setEdgeTriggered(edgeTriggered);
+    server.start();
+
+    // 客户端结束以后退出loop，先不回收子进程(WNOWAIT)，见PollerBench
+    long rw0 = readWriteSyscalls();
+    uint64_t poller0 = loop.pollerSyscalls();
+    long rw = 0;
+    uint64_t pollerCalls = 0;
+    loop.runEvery(0.05, [&]() {
+        siginfo_t info;
+        ::memset(&info, 0, sizeof(info));
+        if (::waitid(P_PID, child, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == child)
+        {
+            rw = readWriteSyscalls() - rw0;
+            pollerCalls = loop.pollerSyscalls() - poller0;
+            loop.quit();
+        }
+    });
+    loop.loop();
+    ::waitpid(child, nullptr, 0);
+
+    long requests = 0;
+    ::read(pipefd[0], &requests, sizeof(requests));
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    if (requests <= 0)
+    {
+        printf("%-6s no requests completed\n", edgeTriggered ? "ET" : "LT");
+        return;
+    }
+    printf("%-6s reply=%7zu  %8.0f req/s  syscalls/req: epoll %.3f + read/write %.3f\n",
+           edgeTriggered ? "ET" : "LT", replySize, static_cast<double>(requests) / seconds,
+           static_cast<double>(pollerCalls) / requests, static_cast<double>(rw) / requests);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int conns = argc > 1 ? atoi(argv[1]) : 50;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9500);
+
+    const size_t replySizes[] = { 64, 256 * 1024, 4 * 1024 * 1024 };
+    for (size_t replySize : replySizes)
+    {
+        run(false, conns, seconds, replySize, port);
+        run(true, conns, seconds, replySize, port);
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * 运行统计(EventLoop::setStatsEnabled / TcpServer::setLoopStats)的开销：
+ * 客户端在fork出的子进程中用conns个连接同时做64字节的ping-pong，持续seconds秒，
+ * 服务器一个subLoop，subLoop上还有一个每10ms执行一次的定时器，分别在关闭和开启统计时运行，
+ * 对比每秒请求数，最后打印开启统计时subLoop的统计结果
+ *
+ * 用法: ./LoopStatsBench [conns] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static const size_t kMessageSize = 64;
+
+// 子进程：conns个连接并发ping-pong，返回完成的请求数
+static long runClient(int conns, int seconds, uint16_t port)
+{
+    int epfd = ::epoll_create1(0);
+    std::vector<int> fds;
+    std::vector<size_t> received(conns, 0);
+    char msg[kMessageSize];
+    ::memset(msg, 'e', sizeof(msg));
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+        ::write(fd, msg, sizeof(msg));
+    }
+
+    long requests = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    epoll_event events[256];
+    char buf[4096];
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int n = ::epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            ssize_t r = ::read(fds[idx], buf, sizeof(buf));
+            if (r <= 0) continue;
+            received[idx] += r;
+            // 收齐一个回显再发下一个
+            while (received[idx] >= kMessageSize)
+            {
+                received[idx] -= kMessageSize;
+                ++requests;
+                ::write(fds[idx], msg, sizeof(msg));
+            }
+        }
+    }
+    // 每个连接上还有一个请求在路上，收完回显再关闭，避免服务器在RST上报错
+    for (int i = 0; i < conns; ++i)
+    {
+        while (received[i] < kMessageSize)
+        {
+            ssize_t r = ::read(fds[i], buf, sizeof(buf));
+            if (r <= 0) break;
+            received[i] += r;
+        }
+        ::close(fds[i]);
+    }
+    return requests;
+}
+
+static void run(bool stats, int conns, int seconds, uint16_t port)
+{
+    int pipefd[2];
+    ::pipe(pipefd);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        long requests = runClient(conns, seconds, port);
+        ::write(pipefd[1], &requests, sizeof(requests));
+        ::_exit(0);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "LoopStatsBench");
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.setThreadNum(1);
+    server.setLoopStats(stats);
+    server.start();
+    EventLoop *ioLoop = server.ioLoops()[0];
+    ioLoop->runEvery(0.01, []() {});
+
+    loop.runEvery(0.05, [&]() {
+        if (::waitpid(child, nullptr, WNOHANG) == child)
+        {
+            loop.quit();
+        }
+    });
+    loop.loop();
+
+    long requests = 0;
+    ::read(pipefd[0], &requests, sizeof(requests));
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    printf("stats %-3s conns=%4d  %8.0f req/s\n", stats ? "on" : "off", conns,
+           static_cast<double>(requests) / seconds);
+    if (stats)
+    {
+        // 在baseLoop线程中读取subLoop的统计
+        printf("%s", ioLoop->stats().toString().c_str());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int conns = argc > 1 ? atoi(argv[1]) : 100;
+    int seconds = argc > 2 ? atoi(argv[2]) : 3;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9800);
+
+    run(false, conns, seconds, port);
+    run(true, conns, seconds, port);
+    return 0;
+}
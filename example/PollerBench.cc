@@ -0,0 +1,178 @@
+/**
+ * echo服务器对比两种IO复用实现：epoll 和 io_uring(见IoUringPoller)
+ * 客户端在fork出的子进程中用conns个连接同时做64字节的ping-pong，持续seconds秒；
+ * 服务器进程统计每个请求平均的系统调用次数：Poller自己的调用(epoll_wait/epoll_ctl或者io_uring_enter)
+ * 加上read/write类调用(/proc/self/io中的syscr/syscw)
+ *
+ * 用法: ./PollerBench [conns] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static const size_t kMessageSize = 64;
+
+// 本进程累计的read类和write类系统调用次数
+static long readWriteSyscalls()
+{
+    FILE *fp = ::fopen("/proc/self/io", "r");
+    if (fp == nullptr)
+    {
+        return 0;
+    }
+    char line[128];
+    long value = 0;
+    long total = 0;
+    while (::fgets(line, sizeof(line), fp) != nullptr)
+    {
+        if (::sscanf(line, "syscr: %ld", &value) == 1 || ::sscanf(line, "syscw: %ld", &value) == 1)
+        {
+            total += value;
+        }
+    }
+    ::fclose(fp);
+    return total;
+}
+
+// 子进程：conns个连接并发ping-pong，返回完成的请求数
+static long runClient(int conns, int seconds, uint16_t port)
+{
+    int epfd = ::epoll_create1(0);
+    std::vector<int> fds;
+    std::vector<size_t> received(conns, 0);
+    char msg[kMessageSize];
+    ::memset(msg, 'e', sizeof(msg));
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+        ::write(fd, msg, sizeof(msg));
+    }
+
+    long requests = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    epoll_event events[256];
+    char buf[4096];
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int n = ::epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            ssize_t r = ::read(fds[idx], buf, sizeof(buf));
+            if (r <= 0) continue;
+            received[idx] += r;
+            // 收齐一个回显再发下一个
+            while (received[idx] >= kMessageSize)
+            {
+                received[idx] -= kMessageSize;
+                ++requests;
+                ::write(fds[idx], msg, sizeof(msg));
+            }
+        }
+    }
+    // 每个连接上还有一个请求在路上，收完回显再关闭，避免服务器在RST上报错
+    for (int i = 0; i < conns; ++i)
+    {
+        while (received[i] < kMessageSize)
+        {
+            ssize_t r = ::read(fds[i], buf, sizeof(buf));
+            if (r <= 0) break;
+            received[i] += r;
+        }
+        ::close(fds[i]);
+    }
+    return requests;
+}
+
+static void run(Poller::Type type, int conns, int seconds, uint16_t port)
+{
+    int pipefd[2];
+    ::pipe(pipefd);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        long requests = runClient(conns, seconds, port);
+        ::write(pipefd[1], &requests, sizeof(requests));
+        ::_exit(0);
+    }
+
+    EventLoop loop(type);
+    TcpServer server(&loop, InetAddress(port), "PollerBench");
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.start();
+    // 客户端结束以后退出loop。先不回收子进程(WNOWAIT)：回收以后子进程的IO统计会累加到父进程的/proc/self/io中
+    long rw0 = readWriteSyscalls();
+    uint64_t poller0 = loop.pollerSyscalls();
+    long rw = 0;
+    uint64_t pollerCalls = 0;
+    loop.runEvery(0.05, [&]() {
+        siginfo_t info;
+        ::memset(&info, 0, sizeof(info));
+        if (::waitid(P_PID, child, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == child)
+        {
+            rw = readWriteSyscalls() - rw0;
+            pollerCalls = loop.pollerSyscalls() - poller0;
+            loop.quit();
+        }
+    });
+    loop.loop();
+    ::waitpid(child, nullptr, 0);
+
+    long requests = 0;
+    ::read(pipefd[0], &requests, sizeof(requests));
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    if (requests <= 0)
+    {
+        printf("%-9s no requests completed\n", loop.pollerName());
+        return;
+    }
+    printf("%-9s conns=%4d  %8.0f req/s  syscalls/req: poller %.3f + read/write %.3f = %.3f\n",
+           loop.pollerName(), conns, static_cast<double>(requests) / seconds,
+           static_cast<double>(pollerCalls) / requests, static_cast<double>(rw) / requests,
+           static_cast<double>(pollerCalls + rw) / requests);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int conns = argc > 1 ? atoi(argv[1]) : 100;
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9400);
+
+    run(Poller::kEpoll, conns, seconds, port);
+    run(Poller::kIoUring, conns, seconds, port);
+    return 0;
+}
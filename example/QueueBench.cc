@@ -0,0 +1,200 @@
+/**
+ * 跨线程任务投递的竞争测试：N个生产者线程同时向同一个loop queueInLoop，
+ * 统计每秒能执行多少个回调，以及平均每个回调引起了多少次write系统调用(唤醒loop的eventfd写入)
+ *
+ * write次数取自/proc/self/io中的syscw，测试期间进程中没有其他写操作
+ *
+ * 另外替换全局operator new统计申请内存的次数，检查任务节点的回收：预热以后，
+ * loop线程自己连续投递100000个任务、以及另一个线程在最多kWindow个任务未执行的情况下投递100000个任务，
+ * queueInLoop都不应该再申请内存
+ *
+ * 用法: ./QueueBench [tasksPerProducer] [maxProducers]
+ */
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+
+static std::atomic<long> g_allocations(0);
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = ::malloc(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    ::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    ::free(p);
+}
+
+// 读取本进程累计的write类系统调用次数
+static long writeSyscalls()
+{
+    FILE *fp = ::fopen("/proc/self/io", "r");
+    if (fp == nullptr)
+    {
+        return -1;
+    }
+    char line[128];
+    long syscw = -1;
+    while (::fgets(line, sizeof(line), fp) != nullptr)
+    {
+        if (::sscanf(line, "syscw: %ld", &syscw) == 1)
+        {
+            break;
+        }
+    }
+    ::fclose(fp);
+    return syscw;
+}
+
+static void bench(EventLoop *loop, int producers, int tasksPerProducer)
+{
+    const long total = static_cast<long>(producers) * tasksPerProducer;
+    long executed = 0;                      // 只在loop线程中修改
+    std::atomic<bool> finished(false);
+
+    long writes0 = writeSyscalls();
+    long allocations0 = g_allocations.load();
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i)
+    {
+        threads.emplace_back([&] {
+            for (int j = 0; j < tasksPerProducer; ++j)
+            {
+                loop->queueInLoop([&] {
+                    if (++executed == total)
+                    {
+                        finished.store(true, std::memory_order_release);
+                    }
+                });
+            }
+        });
+    }
+    for (std::thread &t : threads)
+    {
+        t.join();
+    }
+    while (!finished.load(std::memory_order_acquire))
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    long writes = writeSyscalls() - writes0;
+    long allocations = g_allocations.load() - allocations0;
+
+    printf("producers=%2d  tasks=%9ld  %7.2f M tasks/s  eventfd writes %9ld (%.4f per task)  allocations %.4f per task\n",
+           producers, total, total / seconds / 1e6, writes, static_cast<double>(writes) / total,
+           static_cast<double>(allocations) / total);
+}
+
+static const long kCheckTasks = 100000;
+static const long kWarmupTasks = 10000;
+static const long kWindow = 256;
+
+// loop线程中的任务再投递下一个任务，返回预热以后kCheckTasks个任务期间申请内存的次数
+static long inLoopAllocations(EventLoop *loop)
+{
+    struct Chain
+    {
+        EventLoop *loop;
+        long remaining;
+        long allocations0;
+        std::atomic<long> allocations{-1};
+
+        void step()
+        {
+            if (remaining == kCheckTasks)
+            {
+                allocations0 = g_allocations.load();
+            }
+            if (--remaining < 0)
+            {
+                allocations.store(g_allocations.load() - allocations0, std::memory_order_release);
+                return;
+            }
+            loop->queueInLoop([this] { step(); });
+        }
+    };
+    Chain chain;
+    chain.loop = loop;
+    chain.remaining = kWarmupTasks + kCheckTasks;
+    chain.allocations0 = 0;
+    loop->queueInLoop([&chain] { chain.step(); });
+    while (chain.allocations.load(std::memory_order_acquire) < 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return chain.allocations.load();
+}
+
+// 另一个线程投递，未执行的任务不超过kWindow个，返回预热以后kCheckTasks个任务期间申请内存的次数
+static long crossThreadAllocations(EventLoop *loop)
+{
+    std::atomic<long> executed(0);
+    long allocations = 0;
+    std::thread producer([&] {
+        long allocations0 = 0;
+        for (long i = 0; i < kWarmupTasks + kCheckTasks; ++i)
+        {
+            if (i == kWarmupTasks)
+            {
+                allocations0 = g_allocations.load();
+            }
+            // 预热开始时先突发投递2*kWindow个任务，之后需要的节点一定不会比这更多
+            while (i >= 2 * kWindow && i - executed.load(std::memory_order_acquire) >= kWindow)
+            {
+                std::this_thread::yield();
+            }
+            loop->queueInLoop([&executed] { executed.fetch_add(1, std::memory_order_release); });
+        }
+        allocations = g_allocations.load() - allocations0;
+    });
+    producer.join();
+    while (executed.load(std::memory_order_acquire) < kWarmupTasks + kCheckTasks)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return allocations;
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int tasksPerProducer = argc > 1 ? atoi(argv[1]) : 1000000;
+    int maxProducers = argc > 2 ? atoi(argv[2]) : 8;
+
+    EventLoopThread loopThread;
+    EventLoop *loop = loopThread.startLoop();
+
+    long inLoop = inLoopAllocations(loop);
+    long crossThread = crossThreadAllocations(loop);
+    printf("allocations over %ld tasks after warmup: in-loop %ld, cross-thread %ld  %s\n",
+           kCheckTasks, inLoop, crossThread, inLoop == 0 && crossThread == 0 ? "OK" : "FAILED");
+    for (int producers = 1; producers <= maxProducers; producers *= 2)
+    {
+        bench(loop, producers, tasksPerProducer);
+    }
+    return 0;
+}
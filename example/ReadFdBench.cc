@@ -0,0 +1,118 @@
+/**
+ * 对比两种接收路径每次读取的系统调用次数和耗时：
+ * legacy : 每次读都在栈上准备一个清零的64KB extrabuf，inputBuffer_保持默认大小
+ * scratch: 使用EventLoop的公共溢出区（不清零），并由ReadSizePredictor提前准备inputBuffer_的可写空间
+ *
+ * 用法: ./ReadFdBench [rounds]
+ */
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "ReadSizePredictor.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <chrono>
+#include <sys/socket.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+#else
+static inline uint64_t cycles() { return 0; }
+#endif
+
+struct Result
+{
+    uint64_t reads = 0;
+    uint64_t cycles = 0;
+    uint64_t nanos = 0;
+};
+
+static void writeAll(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0) { perror("write"); exit(1); }
+        data += n;
+        len -= n;
+    }
+}
+
+// 每一轮写入msgSize字节，然后读完这些字节，读到的数据马上被“消费”掉
+template <typename ReadFunc>
+static Result run(int rounds, size_t msgSize, ReadFunc readOnce)
+{
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) { perror("socketpair"); exit(1); }
+    int sndbuf = 4 * 1024 * 1024;
+    ::setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    ::setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sndbuf, sizeof(sndbuf));
+
+    std::string msg(msgSize, 'x');
+    Buffer input;
+    Result r;
+    for (int i = 0; i < rounds; ++i)
+    {
+        writeAll(sv[0], msg.data(), msg.size());
+        size_t got = 0;
+        while (got < msgSize)
+        {
+            auto t0 = std::chrono::steady_clock::now();
+            uint64_t c0 = cycles();
+            ssize_t n = readOnce(sv[1], &input);
+            r.cycles += cycles() - c0;
+            r.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - t0).count();
+            ++r.reads;
+            if (n <= 0) { perror("readv"); exit(1); }
+            got += n;
+            input.retrieveAll();
+        }
+    }
+    ::close(sv[0]);
+    ::close(sv[1]);
+    return r;
+}
+
+static void report(const char *name, size_t msgSize, int rounds, const Result &r)
+{
+    double perMsg = static_cast<double>(r.reads) / rounds;
+    printf("%-8s msg=%7zu  syscalls/msg=%6.2f  cycles/read=%9.0f  ns/read=%8.0f\n",
+           name, msgSize, perMsg,
+           static_cast<double>(r.cycles) / r.reads,
+           static_cast<double>(r.nanos) / r.reads);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    EventLoop loop;     // 只为了拿到loop的公共溢出区
+    const size_t sizes[] = { 20, 512, 4096, 32 * 1024, 256 * 1024 };
+
+    for (size_t msgSize : sizes)
+    {
+        int n = msgSize >= 32 * 1024 ? rounds / 20 : rounds;
+
+        Result legacy = run(n, msgSize, [](int fd, Buffer *buf) {
+            char extrabuf[65536] = {0};     // 旧实现：每次读都清零64KB
+            int err = 0;
+            return buf->readFd(fd, &err, extrabuf, sizeof(extrabuf));
+        });
+
+        ReadSizePredictor predictor;
+        Result scratch = run(n, msgSize, [&](int fd, Buffer *buf) {
+            int err = 0;
+            buf->ensureWritableBytes(predictor.nextReadSize());
+            ssize_t got = buf->readFd(fd, &err, loop.readScratch(), EventLoop::kReadScratchSize);
+            if (got > 0) predictor.record(got);
+            return got;
+        });
+
+        report("legacy", msgSize, n, legacy);
+        report("scratch", msgSize, n, scratch);
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+/**
+ * 回环地址上的TCP代理吞吐量测试，对比两种转发方式：
+ * copy  : onMessage中把inputBuffer_的数据send给对端，配合bindBackpressure做流量控制(数据经过用户态两次拷贝)
+ * splice: TcpRelay::bind，数据通过splice在socket和管道之间移动，不进入用户态
+ *
+ * 服务器只有一个loop，依次接受的两个连接配成一对；客户端向第一个连接写入totalMB的数据，
+ * 从第二个连接读出，写完以后关闭写端，代理把关闭传递给第二个连接，客户端读到EOF时计时结束
+ *
+ * 用法: ./RelayBench [totalMB] [port]
+ */
+#include "TcpServer.h"
+#include "TcpRelay.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static int connectTo(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return fd;
+}
+
+static void forward(const std::weak_ptr<TcpConnection> &weakPeer, const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    TcpConnectionPtr peer = weakPeer.lock();
+    if (peer)
+    {
+        peer->send(buf);
+    }
+    else
+    {
+        buf->retrieveAll();
+    }
+}
+
+static void run(const char *name, bool useSplice, size_t totalBytes, uint16_t port)
+{
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), name);
+    std::weak_ptr<TcpConnection> waiting;       // 等待配对的第一个连接
+
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            TcpConnectionPtr first = waiting.lock();
+            if (!first)
+            {
+                waiting = conn;
+                return;
+            }
+            waiting.reset();
+            if (useSplice)
+            {
+                TcpRelay::bind(first, conn);
+            }
+            else
+            {
+                first->setMessageCallback(std::bind(&forward, std::weak_ptr<TcpConnection>(conn),
+                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                conn->setMessageCallback(std::bind(&forward, std::weak_ptr<TcpConnection>(first),
+                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+                TcpConnection::bindBackpressure(first, conn, TcpRelay::kHighWaterMark, TcpRelay::kLowWaterMark);
+                TcpConnection::bindBackpressure(conn, first, TcpRelay::kHighWaterMark, TcpRelay::kLowWaterMark);
+            }
+            conn->setContext(std::weak_ptr<TcpConnection>(first));
+            first->setContext(std::weak_ptr<TcpConnection>(conn));
+        }
+        else if (conn->getContext().has_value())
+        {
+            // 一端关闭以后关闭另一端的写端(splice路径TcpRelay会在管道排空以后自己关闭，这里重复调用没有影响)
+            TcpConnectionPtr peer = std::any_cast<std::weak_ptr<TcpConnection>>(conn->getContext()).lock();
+            if (peer)
+            {
+                peer->shutdown();
+            }
+        }
+    });
+    server.start();
+
+    size_t received = 0;
+    double seconds = 0;
+    clock_t cpu0 = clock();
+    std::thread client([&] {
+        int src = connectTo(port);
+        int dst = connectTo(port);
+        auto t0 = std::chrono::steady_clock::now();
+        std::thread writer([&] {
+            static char buf[256 * 1024];
+            ::memset(buf, 'r', sizeof(buf));
+            size_t left = totalBytes;
+            while (left > 0)
+            {
+                ssize_t n = ::write(src, buf, left < sizeof(buf) ? left : sizeof(buf));
+                if (n <= 0) break;
+                left -= n;
+            }
+            ::shutdown(src, SHUT_WR);
+        });
+
+        static char buf[256 * 1024];
+        ssize_t n;
+        while ((n = ::read(dst, buf, sizeof(buf))) > 0)
+        {
+            received += n;
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        writer.join();
+        ::close(src);
+        ::close(dst);
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    // 客户端和服务器在同一个进程中，cpu时间包含了客户端读写的开销，两种方式下这部分是相同的
+    double cpu = static_cast<double>(clock() - cpu0) / CLOCKS_PER_SEC;
+
+    printf("%-7s relayed=%6zuMB  %8.1f MB/s  cpu %.2fs%s\n",
+           name, received >> 20, (received >> 20) / seconds, cpu,
+           received == totalBytes ? "" : "  (short read!)");
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    size_t totalMB = argc > 1 ? atoi(argv[1]) : 2048;
+    uint16_t port = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 9200);
+
+    run("copy", false, totalMB << 20, port);
+    run("splice", true, totalMB << 20, port);
+    return 0;
+}
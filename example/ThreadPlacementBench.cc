@@ -0,0 +1,214 @@
+/**
+ * subLoop线程的放置策略(TcpServer::setThreadNum的ThreadPlacement参数)：
+ * 先打印本机上几种策略得到的CPU分组，然后客户端在fork出的子进程中用conns个连接做64字节的ping-pong，持续seconds秒，
+ * 服务器threads个subLoop，分别不绑定、onePerCore、onePerCore(skipCore0)，
+ * 输出每秒请求数、每个subLoop线程允许的CPU以及它在CPU之间迁移的次数(/proc/self/task/<tid>/sched中的se.nr_migrations)
+ *
+ * 用法: ./ThreadPlacementBench [threads] [conns] [seconds] [port]
+ */
+#include "TcpServer.h"
+#include "ThreadPlacement.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+static const size_t kMessageSize = 64;
+
+// 子进程：conns个连接并发ping-pong，返回完成的请求数
+static long runClient(int conns, int seconds, uint16_t port)
+{
+    int epfd = ::epoll_create1(0);
+    std::vector<int> fds;
+    std::vector<size_t> received(conns, 0);
+    char msg[kMessageSize];
+    ::memset(msg, 'e', sizeof(msg));
+    for (int i = 0; i < conns; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        ::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ::epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        fds.push_back(fd);
+        ::write(fd, msg, sizeof(msg));
+    }
+
+    long requests = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    epoll_event events[256];
+    char buf[4096];
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        int n = ::epoll_wait(epfd, events, 256, 100);
+        for (int i = 0; i < n; ++i)
+        {
+            int idx = events[i].data.u32;
+            ssize_t r = ::read(fds[idx], buf, sizeof(buf));
+            if (r <= 0) continue;
+            received[idx] += r;
+            // 收齐一个回显再发下一个
+            while (received[idx] >= kMessageSize)
+            {
+                received[idx] -= kMessageSize;
+                ++requests;
+                ::write(fds[idx], msg, sizeof(msg));
+            }
+        }
+    }
+    // 每个连接上还有一个请求在路上，收完回显再关闭，避免服务器在RST上报错
+    for (int i = 0; i < conns; ++i)
+    {
+        while (received[i] < kMessageSize)
+        {
+            ssize_t r = ::read(fds[i], buf, sizeof(buf));
+            if (r <= 0) break;
+            received[i] += r;
+        }
+        ::close(fds[i]);
+    }
+    return requests;
+}
+
+// 线程tid迁移的次数，没有这项统计时返回-1
+static long migrations(pid_t tid)
+{
+    char path[64];
+    ::snprintf(path, sizeof(path), "/proc/self/task/%d/sched", tid);
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    while (::fgets(line, sizeof(line), fp) != nullptr)
+    {
+        if (::strncmp(line, "se.nr_migrations", 16) == 0)
+        {
+            const char *colon = ::strchr(line, ':');
+            if (colon != nullptr)
+            {
+                value = ::atol(colon + 1);
+            }
+            break;
+        }
+    }
+    ::fclose(fp);
+    return value;
+}
+
+static std::string affinityOf(pid_t tid)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(tid, sizeof(set), &set) < 0)
+    {
+        return "?";
+    }
+    std::string out;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (CPU_ISSET(cpu, &set))
+        {
+            if (!out.empty()) out += ',';
+            out += std::to_string(cpu);
+        }
+    }
+    return out;
+}
+
+static void run(const char *name, const ThreadPlacement &placement, int threads, int conns, int seconds, uint16_t port)
+{
+    int pipefd[2];
+    ::pipe(pipefd);
+    pid_t child = ::fork();
+    if (child == 0)
+    {
+        long requests = runClient(conns, seconds, port);
+        ::write(pipefd[1], &requests, sizeof(requests));
+        ::_exit(0);
+    }
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "ThreadPlacementBench");
+    server.setMessageCallback([](const TcpConnectionPtr &conn, Buffer *buf, Timestamp) {
+        conn->send(buf);
+    });
+    server.setThreadNum(threads, placement);
+    server.start();
+
+    std::vector<pid_t> tids;
+    for (EventLoop *ioLoop : server.ioLoops())
+    {
+        tids.push_back(ioLoop->threadId());
+    }
+    std::vector<long> migrations0;
+    for (pid_t tid : tids)
+    {
+        migrations0.push_back(migrations(tid));
+    }
+
+    loop.runEvery(0.05, [&]() {
+        if (::waitpid(child, nullptr, WNOHANG) == child)
+        {
+            loop.quit();
+        }
+    });
+    loop.loop();
+
+    long requests = 0;
+    ::read(pipefd[0], &requests, sizeof(requests));
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    printf("%-18s %8.0f req/s ", name, static_cast<double>(requests) / seconds);
+    for (size_t i = 0; i < tids.size(); ++i)
+    {
+        long n = migrations(tids[i]);
+        printf(" | cpus %s migrations %ld", affinityOf(tids[i]).c_str(), n < 0 ? -1 : n - migrations0[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    int threads = argc > 1 ? atoi(argv[1]) : 2;
+    int conns = argc > 2 ? atoi(argv[2]) : 100;
+    int seconds = argc > 3 ? atoi(argv[3]) : 3;
+    uint16_t port = static_cast<uint16_t>(argc > 4 ? atoi(argv[4]) : 9950);
+
+    printf("onePerCore          %s\n", ThreadPlacement::onePerCore().toString().c_str());
+    printf("onePerCore(skip 0)  %s\n", ThreadPlacement::onePerCore(true).toString().c_str());
+    printf("perNumaNode         %s\n", ThreadPlacement::perNumaNode().toString().c_str());
+
+    run("any", ThreadPlacement(), threads, conns, seconds, port);
+    run("onePerCore", ThreadPlacement::onePerCore(), threads, conns, seconds, port);
+    run("onePerCore(skip 0)", ThreadPlacement::onePerCore(true), threads, conns, seconds, port);
+    return 0;
+}
@@ -0,0 +1,118 @@
+/**
+ * 回环地址上的发送吞吐量测试，对比两种发送方式：
+ * copy    : 普通的write/writev，数据拷贝进内核
+ * zerocopy: TcpConnection::setZeroCopy(true)，大于阈值的PayloadPtr用MSG_ZEROCOPY发送
+ *
+ * 注意：发往本机回环地址的数据，内核最终还是会拷贝一次(完成通知里带SO_EE_CODE_ZEROCOPY_COPIED)，
+ * 所以这里主要用来观察零拷贝路径本身的开销(页锁定+完成通知)；真正的收益要在物理网卡上测量，
+ * 此时把客户端放到另一台机器上即可
+ *
+ * 用法: ./ZeroCopyBench [payloadKB] [totalMB] [port]
+ */
+#include "TcpServer.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <thread>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+struct Options
+{
+    size_t payloadSize;
+    size_t count;       // 一共发送多少个payload
+    uint16_t port;
+};
+
+// 客户端：连接服务器，一直读到对端关闭，返回收到的字节数
+static size_t drain(uint16_t port)
+{
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    while (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    static char buf[256 * 1024];
+    size_t total = 0;
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0)
+    {
+        total += n;
+    }
+    ::close(fd);
+    return total;
+}
+
+static void run(const char *name, bool zeroCopy, const Options &opt)
+{
+    PayloadPtr payload = makePayload(std::string(opt.payloadSize, 'z'));
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(opt.port), name);
+    size_t sent = 0;
+
+    // 每次发送队列清空时再补一批，直到发完count个payload
+    auto sendMore = [&](const TcpConnectionPtr &conn) {
+        for (int i = 0; i < 8 && sent < opt.count; ++i, ++sent)
+        {
+            conn->send(payload);
+        }
+        if (sent == opt.count)
+        {
+            conn->shutdown();
+        }
+    };
+    server.setConnectionCallback([&](const TcpConnectionPtr &conn) {
+        if (conn->connected())
+        {
+            conn->setZeroCopy(zeroCopy, 64 * 1024);
+            sendMore(conn);
+        }
+    });
+    server.setWriteCompleteCallback([&](const TcpConnectionPtr &conn) {
+        if (sent < opt.count) sendMore(conn);
+    });
+    server.start();
+
+    size_t received = 0;
+    double seconds = 0;
+    clock_t cpu0 = clock();
+    std::thread client([&] {
+        auto t0 = std::chrono::steady_clock::now();
+        received = drain(opt.port);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        loop.quit();
+    });
+    loop.loop();
+    client.join();
+    double cpu = static_cast<double>(clock() - cpu0) / CLOCKS_PER_SEC;
+
+    printf("%-9s payload=%6zuKB  received=%6zuMB  %8.1f MB/s  cpu %.2fs\n",
+           name, opt.payloadSize / 1024, received >> 20, (received >> 20) / seconds, cpu);
+}
+
+int main(int argc, char *argv[])
+{
+    Logger::setLogLevel(Logger::ERROR);
+
+    Options opt;
+    opt.payloadSize = (argc > 1 ? atoi(argv[1]) : 256) * 1024;
+    size_t totalMB = argc > 2 ? atoi(argv[2]) : 2048;
+    opt.count = (totalMB << 20) / opt.payloadSize;
+    opt.port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 9100);
+
+    run("copy", false, opt);
+    run("zerocopy", true, opt);
+    return 0;
+}
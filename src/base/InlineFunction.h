@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <functional>
+
+template <typename Signature, size_t Capacity = 64>
+class InlineFunction;
+
+/**
+ * 只能移动、不能拷贝的函数对象，可调用对象直接存放在对象内部Capacity字节的空间里，永远不会申请堆内存。
+ * 用来代替EventLoop任务、定时器和Channel回调中的std::function：std::function的小对象优化只有16字节，
+ * 捕获了一个shared_ptr再加几个参数的lambda或者std::bind的结果就会在堆上分配，而且每次拷贝都要重新分配
+ *
+ * 可调用对象超过Capacity时编译失败(static_assert)，这时应该减少捕获的内容，或者把数据放进shared_ptr中捕获
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity>
+{
+public:
+    InlineFunction() noexcept : ops_(nullptr) {}
+    InlineFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, InlineFunction>::value>::type>
+    InlineFunction(F &&f) : ops_(nullptr)
+    {
+        using Fn = typename std::decay<F>::type;
+        static_assert(sizeof(Fn) <= Capacity, "callable is too large for InlineFunction, capture less or capture a shared_ptr");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "callable is over-aligned for InlineFunction");
+        static_assert(std::is_nothrow_move_constructible<Fn>::value, "callable must be nothrow move constructible");
+        if (isNull(f))
+        {
+            return;
+        }
+        ::new (static_cast<void*>(&storage_)) Fn(std::forward<F>(f));
+        ops_ = &Ops<Fn>::kTable;
+    }
+
+    InlineFunction(InlineFunction &&other) noexcept : ops_(other.ops_)
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->relocate(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InlineFunction& operator=(InlineFunction &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            if (other.ops_ != nullptr)
+            {
+                other.ops_->relocate(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InlineFunction& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    ~InlineFunction() { reset(); }
+
+    // 与std::function一样，operator()是const的，可调用对象本身可以修改自己捕获的状态
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(const_cast<void*>(static_cast<const void*>(&storage_)), std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    // 析构保存的可调用对象(释放它捕获的资源)，之后为空
+    void reset() noexcept
+    {
+        if (ops_ != nullptr)
+        {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    // 每种可调用类型一张操作表，InlineFunction本身只多存一个指针
+    struct OpsTable
+    {
+        R (*invoke)(void *fn, Args&&... args);
+        void (*relocate)(void *dst, void *src);     // 移动到dst并析构src
+        void (*destroy)(void *fn);
+    };
+
+    template <typename Fn>
+    struct Ops
+    {
+        static R invoke(void *fn, Args&&... args)
+        {
+            return (*static_cast<Fn*>(fn))(std::forward<Args>(args)...);
+        }
+        static void relocate(void *dst, void *src)
+        {
+            Fn *from = static_cast<Fn*>(src);
+            ::new (dst) Fn(std::move(*from));
+            from->~Fn();
+        }
+        static void destroy(void *fn)
+        {
+            static_cast<Fn*>(fn)->~Fn();
+        }
+        static constexpr OpsTable kTable = { &Ops::invoke, &Ops::relocate, &Ops::destroy };
+    };
+
+    // 空的函数指针和空的std::function按照空的InlineFunction处理
+    template <typename F>
+    static bool isNull(const F&) { return false; }
+    template <typename Ret, typename... As>
+    static bool isNull(Ret (* const &fp)(As...)) { return fp == nullptr; }
+    template <typename Sig>
+    static bool isNull(const std::function<Sig> &f) { return !f; }
+
+    typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type storage_;
+    const OpsTable *ops_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+
+/**
+ * 侵入式的无锁多生产者单消费者队列(Dmitry Vyukov的MPSC算法)
+ * 使用者让自己的节点类型继承MpscNode，队列只负责把节点串起来，不分配也不释放内存
+ *
+ * push: 任意线程调用，一次原子exchange加一次store，不会失败也不会重试
+ * pop : 只能由唯一的消费者线程调用。某个生产者exchange之后、链接next之前被切换出去时，
+ *       它后面的节点暂时不可见，pop会返回nullptr，稍后再取即可(不会丢失)
+ *
+ *   tail_(消费者)                                  head_(生产者)
+ *     v                                               v
+ *   [stub/已取出] -> [node] -> [node] -> ... -> [最后push的node]
+ */
+struct MpscNode
+{
+    std::atomic<MpscNode*> next{nullptr};
+};
+
+class MpscQueue : noncopyable
+{
+public:
+    MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+    void push(MpscNode *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        MpscNode *prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 队列为空(或者队首的生产者还没有完成push)时返回nullptr
+    MpscNode* pop()
+    {
+        MpscNode *tail = tail_;
+        MpscNode *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &stub_)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            tail_ = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+        // tail是最后一个可见的节点，只有它确实是队尾时才能取出：先把stub_放回队尾，保证队列中始终至少有一个节点
+        if (tail != head_.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        push(&stub_);
+        next = tail->next.load(std::memory_order_acquire);
+        if (next != nullptr)
+        {
+            tail_ = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    // head_和tail_分别被生产者和消费者频繁修改，放在不同的cache line上
+    alignas(64) std::atomic<MpscNode*> head_;   // 最后push的节点，生产者竞争修改
+    alignas(64) MpscNode *tail_;                // 下一个要取出的节点，只有消费者访问
+    MpscNode stub_;                             // 哨兵节点，队列为空时head_和tail_都指向它
+};
@@ -12,6 +12,7 @@ Thread::Thread(ThreadFunc func, const std::string &name)
     , tid_(0)
     , func_(std::move(func))
     , name_(name)
+    , placementIndex_(0)
 {
     setDefaultName();
 }
@@ -35,6 +36,10 @@ void Thread::start()
     thread_ = std::shared_ptr<std::thread>(new std::thread([&](){
         // 获取线程tid
         tid_ = CurrentThread::tid();
+        if (!placement_.empty())
+        {
+            placement_.apply(placementIndex_);
+        }
         // v操作，信号量+1
         sem_post(&sem);
         // 开启一个新线程专门执行该线程函数
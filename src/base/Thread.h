@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "ThreadPlacement.h"
 
 #include <thread>
 #include <functional>
@@ -16,6 +17,13 @@ public:
     explicit Thread(ThreadFunc, const std::string &name = std::string());
     ~Thread();
 
+    // 新线程开始执行func之前把自己放到placement的第index个槽上(见ThreadPlacement)，在start之前设置
+    void setPlacement(const ThreadPlacement &placement, int index)
+    {
+        placement_ = placement;
+        placementIndex_ = index;
+    }
+
     void start();                   // 创建/开始启动线程
     void join();
 
@@ -33,5 +41,7 @@ private:
     pid_t tid_;                     // 线程id
     ThreadFunc func_;               // 线程运行函数
     std::string name_;
+    ThreadPlacement placement_;
+    int placementIndex_;
     static std::atomic_int32_t numCreated_; // 线程索引
 };
@@ -0,0 +1,304 @@
+#include "ThreadPlacement.h"
+#include "CurrentThread.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+namespace
+{
+
+// 本进程允许使用的CPU
+std::vector<int> allowedCpus()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (::sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+bool isAllowed(const std::vector<int> &allowed, int cpu)
+{
+    return std::binary_search(allowed.begin(), allowed.end(), cpu);
+}
+
+// 读取只有一个整数的sysfs文件，失败时返回-1
+int readSysInt(const char *path)
+{
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return -1;
+    }
+    int value = -1;
+    if (::fscanf(fp, "%d", &value) != 1)
+    {
+        value = -1;
+    }
+    ::fclose(fp);
+    return value;
+}
+
+// 解析"0-3,8,10-11"格式的CPU列表
+std::vector<int> readCpuList(const char *path)
+{
+    std::vector<int> cpus;
+    FILE *fp = ::fopen(path, "r");
+    if (fp == nullptr)
+    {
+        return cpus;
+    }
+    char line[4096];
+    if (::fgets(line, sizeof(line), fp) != nullptr)
+    {
+        char *save = nullptr;
+        for (char *token = ::strtok_r(line, ",\n", &save); token != nullptr; token = ::strtok_r(nullptr, ",\n", &save))
+        {
+            int first = 0;
+            int last = 0;
+            int n = ::sscanf(token, "%d-%d", &first, &last);
+            if (n == 1)
+            {
+                last = first;
+            }
+            if (n >= 1)
+            {
+                for (int cpu = first; cpu <= last; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+    }
+    ::fclose(fp);
+    return cpus;
+}
+
+std::string cpusToString(const std::vector<int> &cpus)
+{
+    std::string out;
+    for (size_t i = 0; i < cpus.size(); ++i)
+    {
+        if (i > 0) out += ',';
+        out += std::to_string(cpus[i]);
+    }
+    return out;
+}
+
+} // namespace
+
+ThreadPlacement::ThreadPlacement()
+    : fifoPriority_(0)
+    , nice_(0)
+    , hasNice_(false)
+{
+}
+
+ThreadPlacement ThreadPlacement::cpuList(const std::vector<int> &cpus)
+{
+    ThreadPlacement placement;
+    std::vector<int> allowed = allowedCpus();
+    for (int cpu : cpus)
+    {
+        if (isAllowed(allowed, cpu))
+        {
+            placement.slots_.push_back(std::vector<int>(1, cpu));
+        }
+        else
+        {
+            LOG_WARN << "ThreadPlacement::cpuList cpu " << cpu << " is not available to this process";
+        }
+    }
+    return placement;
+}
+
+ThreadPlacement ThreadPlacement::cpuSet(const std::vector<int> &cpus)
+{
+    ThreadPlacement placement;
+    std::vector<int> allowed = allowedCpus();
+    std::vector<int> slot;
+    for (int cpu : cpus)
+    {
+        if (isAllowed(allowed, cpu))
+        {
+            slot.push_back(cpu);
+        }
+    }
+    if (!slot.empty())
+    {
+        placement.slots_.push_back(slot);
+    }
+    return placement;
+}
+
+ThreadPlacement ThreadPlacement::onePerCore(bool skipCore0)
+{
+    ThreadPlacement placement;
+    std::vector<int> allowed = allowedCpus();
+    // (package, core) -> 这个物理核上的第一个CPU；读不到拓扑时把每个CPU当成一个核
+    std::map<std::pair<int, int>, int> cores;
+    std::pair<int, int> core0(-1, -1);
+    for (int cpu : allowed)
+    {
+        char path[128];
+        ::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = readSysInt(path);
+        ::snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        int core = readSysInt(path);
+        std::pair<int, int> key = core < 0 ? std::make_pair(-1, cpu) : std::make_pair(package, core);
+        if (cpu == 0)
+        {
+            core0 = key;
+        }
+        cores.emplace(key, cpu);
+    }
+    std::vector<int> firstCpus;
+    for (const auto &item : cores)
+    {
+        if (skipCore0 && item.first == core0)
+        {
+            continue;
+        }
+        firstCpus.push_back(item.second);
+    }
+    std::sort(firstCpus.begin(), firstCpus.end());
+    for (int cpu : firstCpus)
+    {
+        placement.slots_.push_back(std::vector<int>(1, cpu));
+    }
+    if (placement.slots_.empty())
+    {
+        LOG_WARN << "ThreadPlacement::onePerCore no core available, threads are not pinned";
+    }
+    return placement;
+}
+
+ThreadPlacement ThreadPlacement::perNumaNode()
+{
+    ThreadPlacement placement;
+    std::vector<int> allowed = allowedCpus();
+    std::vector<int> nodes = readCpuList("/sys/devices/system/node/online");
+    for (int node : nodes)
+    {
+        char path[128];
+        ::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        std::vector<int> slot;
+        for (int cpu : readCpuList(path))
+        {
+            if (isAllowed(allowed, cpu))
+            {
+                slot.push_back(cpu);
+            }
+        }
+        if (!slot.empty())
+        {
+            placement.slots_.push_back(slot);
+        }
+    }
+    // 没有NUMA信息时当作只有一个节点
+    if (placement.slots_.empty() && !allowed.empty())
+    {
+        placement.slots_.push_back(allowed);
+    }
+    return placement;
+}
+
+const std::vector<int>& ThreadPlacement::cpusFor(int index) const
+{
+    static const std::vector<int> kNoCpus;
+    if (slots_.empty())
+    {
+        return kNoCpus;
+    }
+    return slots_[static_cast<size_t>(index) % slots_.size()];
+}
+
+bool ThreadPlacement::apply(int index) const
+{
+    bool ok = true;
+    const std::vector<int> &cpus = cpusFor(index);
+    if (!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : cpus)
+        {
+            CPU_SET(cpu, &set);
+        }
+        int err = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+        if (err != 0)
+        {
+            LOG_WARN << "ThreadPlacement::apply setaffinity to cpus " << cpusToString(cpus) << " failed, errno=" << err;
+            ok = false;
+        }
+    }
+    if (fifoPriority_ > 0)
+    {
+        struct sched_param param;
+        ::memset(&param, 0, sizeof(param));
+        param.sched_priority = fifoPriority_;
+        int err = ::pthread_setschedparam(::pthread_self(), SCHED_FIFO, &param);
+        if (err != 0)
+        {
+            LOG_WARN << "ThreadPlacement::apply SCHED_FIFO priority " << fifoPriority_ << " failed, errno=" << err;
+            ok = false;
+        }
+    }
+    if (hasNice_)
+    {
+        // Linux上nice值是每个线程的属性，PRIO_PROCESS加上tid只影响这个线程
+        if (::setpriority(PRIO_PROCESS, static_cast<id_t>(CurrentThread::tid()), nice_) < 0)
+        {
+            LOG_WARN << "ThreadPlacement::apply nice " << nice_ << " failed, errno=" << errno;
+            ok = false;
+        }
+    }
+    if (!empty())
+    {
+        LOG_INFO << "thread " << CurrentThread::tid() << " placed: cpus "
+                 << (cpus.empty() ? std::string("any") : cpusToString(cpus))
+                 << (fifoPriority_ > 0 ? " SCHED_FIFO " + std::to_string(fifoPriority_) : std::string())
+                 << (hasNice_ ? " nice " + std::to_string(nice_) : std::string());
+    }
+    return ok;
+}
+
+std::string ThreadPlacement::toString() const
+{
+    std::string out;
+    for (size_t i = 0; i < slots_.size(); ++i)
+    {
+        if (i > 0) out += ' ';
+        out += '[' + cpusToString(slots_[i]) + ']';
+    }
+    if (out.empty())
+    {
+        out = "any";
+    }
+    if (fifoPriority_ > 0)
+    {
+        out += " SCHED_FIFO " + std::to_string(fifoPriority_);
+    }
+    if (hasNice_)
+    {
+        out += " nice " + std::to_string(nice_);
+    }
+    return out;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * 线程的放置策略：绑定到哪些CPU，以及调度策略(SCHED_FIFO)或者nice值。
+ * 线程不绑核时会在CPU之间迁移，每次迁移都要在新的核上重新把缓存热起来。
+ *
+ * 一个策略由若干个槽组成，第index个线程放到第index % 槽数个槽上，每个槽是一组CPU：
+ *   cpuList({2, 3, 4})       每个槽一个CPU：第0个线程在CPU 2上，第1个在CPU 3上...
+ *   cpuSet({2, 3, 4})        只有一个槽：所有线程都可以在这3个CPU上运行，由内核调度
+ *   onePerCore(skipCore0)    每个物理核一个槽(超线程的兄弟只取第一个)，skipCore0时跳过0号核，
+ *                            0号核一般要处理更多的中断和系统任务
+ *   perNumaNode()            每个NUMA节点一个槽，线程在节点内的CPU上运行，
+ *                            内存默认在首次访问的节点上分配，loop的内存也就在本地节点上
+ * 只包含本进程允许使用的CPU(sched_getaffinity)，一个槽都没有时不绑定CPU。
+ * 在工厂函数中读取/sys的拓扑信息，之后可以随意拷贝。
+ *
+ * apply在要放置的线程中调用(见Thread::setPlacement)，失败(例如没有CAP_SYS_NICE时设置SCHED_FIFO)只打印日志
+ */
+class ThreadPlacement
+{
+public:
+    // 什么也不做
+    ThreadPlacement();
+
+    static ThreadPlacement cpuList(const std::vector<int> &cpus);
+    static ThreadPlacement cpuSet(const std::vector<int> &cpus);
+    static ThreadPlacement onePerCore(bool skipCore0 = false);
+    static ThreadPlacement perNumaNode();
+
+    // 使用SCHED_FIFO实时调度，priority为1~99。loop线程忙起来会一直占着CPU，同一个核上的普通线程会饿死，慎用
+    ThreadPlacement& setSchedFifo(int priority) { fifoPriority_ = priority; return *this; }
+    // 设置nice值(-20~19)，小于0需要CAP_SYS_NICE
+    ThreadPlacement& setNice(int nice) { nice_ = nice; hasNice_ = true; return *this; }
+
+    bool empty() const { return slots_.empty() && fifoPriority_ == 0 && !hasNice_; }
+    size_t numSlots() const { return slots_.size(); }
+    // 第index个线程可以使用的CPU，为空表示不绑定
+    const std::vector<int>& cpusFor(int index) const;
+
+    // 把当前线程放到第index个槽上，全部成功时返回true
+    bool apply(int index) const;
+
+    std::string toString() const;
+
+private:
+    std::vector<std::vector<int>> slots_;
+    int fifoPriority_;          // 0表示不使用SCHED_FIFO
+    int nice_;
+    bool hasNice_;
+};
@@ -27,6 +27,7 @@ void ThreadPool::start(int numThreads)
         char id[32];
         snprintf(id, sizeof(id), "%d", i+1);
         threads_.emplace_back(new Thread(std::bind(&ThreadPool::runInThread, this), name_+id));
+        threads_[i]->setPlacement(placement_, i);
         threads_[i]->start();
     }
     // 如果不创建线程则直接在本线程中执行回调
@@ -21,6 +21,8 @@ public:
     ~ThreadPool();
 
     void setThreadInitCallback(const Task& cb) { threadInitCallback_ = cb; }
+    // 工作线程的放置策略(见ThreadPlacement)，第i个线程放到第i个槽上，在start之前设置
+    void setPlacement(const ThreadPlacement &placement) { placement_ = placement; }
     // 启动numThreads个线程
     void start(int numThreads);
     void stop();
@@ -38,6 +40,7 @@ private:
     std::condition_variable cond_;
     std::string name_;
     Task threadInitCallback_;
+    ThreadPlacement placement_;
     std::vector<std::unique_ptr<Thread>> threads_;
     std::deque<Task> queue_;
     std::atomic_bool running_;
@@ -1,4 +1,5 @@
 #include "Buffer.h"
+#include "ByteSearch.h"
 #include "HttpContext.h"
 #include "Logging.h"
 
@@ -15,14 +16,14 @@ bool HttpContext::processRequestLine(const char* begin, const char* end)
     
     bool succeed = false;
     const char *start = begin;
-    const char *space = std::find(start, end, ' ');         // 返回空格所在位置
+    const char *space = bytesearch::findChar(start, end, ' ');  // 返回空格所在位置
     if (space != end && request_.setMethod(start, space))   // 判断请求方法是否有效
     {
         start = space + 1;                                  // 跳过空格
-        space = std::find(start, end, ' ');                 // 继续寻找下一个空格
+        space = bytesearch::findChar(start, end, ' ');      // 继续寻找下一个空格
         if (space != end)
         {
-            const char* question = std::find(start, space, '?');    // path和query是用"？"隔开的
+            const char* question = bytesearch::findChar(start, space, '?');    // path和query是用"？"隔开的
             if (question != space)
             {
                 request_.setPath(start, question);
@@ -88,7 +89,7 @@ bool HttpContext::parseRequest(Buffer *buf, Timestamp receiveTime)
             if (crlf)
             {
                 // 找到“：”位置
-                const char *colon = std::find(buf->peek(), crlf, ':');
+                const char *colon = bytesearch::findChar(buf->peek(), crlf, ':');
                 if (colon != crlf)
                 {
                     request_.addHeader(buf->peek(), colon, crlf);
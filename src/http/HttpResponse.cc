@@ -1,12 +1,26 @@
 
 #include "HttpResponse.h"
 #include "Buffer.h"
+#include "SendList.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
 
-void HttpResponse::appendToBuffer(Buffer * output) const{
+void HttpResponse::appendToBuffer(Buffer * output) const
+{
+    appendHeaderToBuffer(output);
+    output->append(body_);
+}
+
+void HttpResponse::appendToSendList(Buffer* header, SendList* list) const
+{
+    appendHeaderToBuffer(header);
+    list->append(header->peek(), header->readableBytes());
+    list->append(body_);
+}
+
+void HttpResponse::appendHeaderToBuffer(Buffer * output) const{
     /*典型的响应消息： 
      *   HTTP/1.1 200 OK 
      *   Date:Mon,31Dec200104:25:57GMT 
@@ -45,5 +59,4 @@ void HttpResponse::appendToBuffer(Buffer * output) const{
     }
     
     output->append("\r\n");
-    output->append(body_);
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 
 class Buffer;
+class SendList;
 
 class HttpResponse
 {
@@ -39,6 +40,13 @@ public:
     void setBody(const std::string& body) { body_ = body; }
 
     void appendToBuffer(Buffer* output) const;
+
+    // 只把状态行和头部(包括结尾的空行)写入output
+    void appendHeaderToBuffer(Buffer* output) const;
+
+    // 头部写入header，然后把header和消息体作为两段加入list，消息体不拷贝，直接引用body_。
+    // 因此send(list)之前header和本对象都必须有效
+    void appendToSendList(Buffer* header, SendList* list) const;
     
 private:
     std::map<std::string, std::string> headers_;
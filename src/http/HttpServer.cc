@@ -73,9 +73,11 @@ void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req)
         (req.version() == HttpRequest::kHttp10 && connection != "Keep-Alive");
     HttpResponse response(close);
     httpCallback_(req, &response);      // httpCallback_由用户给定，便于用户可以自定义当请求到来时，应该给客户端返回什么信息
-    Buffer buf;
-    response.appendToBuffer(&buf);
-    conn->send(&buf);
+    // 头部和消息体作为两段用一次writev发送，消息体不再拷贝到临时Buffer中
+    Buffer header;
+    SendList list;
+    response.appendToSendList(&header, &list);
+    conn->send(list);
     if (response.closeConnection())
     {
         LOG_DEBUG << "the server close http connection, named: " << conn->name();
@@ -24,6 +24,9 @@ public:
         }
     }
 
+    // 后端线程的放置策略(见ThreadPlacement)，例如和loop线程错开的核、较低的优先级，在start之前设置
+    void setPlacement(const ThreadPlacement &placement) { thread_.setPlacement(placement, 0); }
+
     // 前端调用 append 写入日志
     void append(const char* logling, int len);
 
@@ -2,6 +2,7 @@
 #include "Logging.h"
 #include "InetAddress.h"
 
+#include <errno.h>
 #include <functional>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -25,6 +26,10 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &ListenAddr, bool reusepor
     , acceptChannel_(loop, acceptSocket_.fd())
     , listenning_(false)
     , idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    , backlog_(kDefaultBacklog)
+    , deferAcceptSeconds_(0)
+    , fastOpenQueue_(0)
+    , maxAcceptsPerEvent_(kDefaultMaxAcceptsPerEvent)
 {
     LOG_DEBUG << "Acceptor create nonblocking socket, [fd = " << acceptChannel_.fd() << "]";
     acceptSocket_.setReuseAddr(reuseport);
@@ -37,52 +42,84 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress &ListenAddr, bool reusepor
 
 Acceptor::~Acceptor()
 {
-    // 把从Poller中感兴趣的事件删除掉
-    acceptChannel_.disableAll();    
-    // 调用EventLoop->removeChannel => EPoller->removeChannel 把EPoller的ChannelMap对应的部分删除
-    acceptChannel_.remove();    
+    if (loop_ != nullptr)
+    {
+        // 把从Poller中感兴趣的事件删除掉
+        acceptChannel_.disableAll();    
+        // 调用EventLoop->removeChannel => EPoller->removeChannel 把EPoller的ChannelMap对应的部分删除
+        acceptChannel_.remove();    
+    }
     ::close(idleFd_);   
 }
 
+void Acceptor::detachLoop()
+{
+    loop_ = nullptr;
+    acceptChannel_.detachLoop();
+}
+
 void Acceptor::listen()
 {
     // 表示正在监听
     listenning_ = true;
-    acceptSocket_.listen();
+    if (deferAcceptSeconds_ > 0)
+    {
+        acceptSocket_.setDeferAccept(deferAcceptSeconds_);
+    }
+    if (fastOpenQueue_ > 0)
+    {
+        acceptSocket_.setFastOpen(fastOpenQueue_);
+    }
+    acceptSocket_.listen(backlog_);
     // 将acceptChannel的读事件注册到poller
     acceptChannel_.enableReading();
 }
 
-// listenfd有事件发生了，就是有新用户连接了
+// listenfd有事件发生了，就是有新用户连接了。一直accept到队列空了(EAGAIN)，最多maxAcceptsPerEvent_个，
+// 剩下的留给下一轮(监听socket是水平触发的)
 void Acceptor::handleRead()
 {
     // 使用了InetAddress类型定义对象，需要包含头文件
     // 之前为了不加载头文件使用了前置声明
     InetAddress peerAddr;
-    // 接受新连接
-    int connfd = acceptSocket_.accept(&peerAddr);
-    // 确实有新连接到来
-    if (connfd >= 0)
+    for (int i = 0; i < maxAcceptsPerEvent_; ++i)
     {
-        if (newConnectionCallback_)
+        // 接受新连接
+        int connfd = acceptSocket_.accept(&peerAddr);
+        // 确实有新连接到来
+        if (connfd >= 0)
         {
-            // 分发连接到subloop
-            newConnectionCallback_(connfd, peerAddr); 
+            if (newConnectionCallback_)
+            {
+                // 分发连接到subloop
+                newConnectionCallback_(connfd, peerAddr); 
+            }
+            else
+            {
+                LOG_DEBUG << "no newConnectionCallback() function";
+                ::close(connfd);
+            }
+            continue;
         }
-        else
+
+        int savedErrno = errno;
+        // 队列已经空了
+        if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK)
         {
-            LOG_DEBUG << "no newConnectionCallback() function";
-            ::close(connfd);
+            break;
         }
-    }
-    else
-    {
+        // 连接在accept之前被客户端重置了，接着处理后面的连接
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR)
+        {
+            continue;
+        }
+
         LOG_ERROR << "accept() failed";
 
         // 当前进程的fd已经用完了
         // 可以调整单个服务器的fd上限
         // 也可以分布式部署
-        if (errno == EMFILE)
+        if (savedErrno == EMFILE)
         {
             LOG_INFO << "sockfd reached limit";
             ::close(idleFd_);
@@ -92,5 +129,6 @@ void Acceptor::handleRead()
             // 重新占位
             idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
         }
+        break;
     }
-}
\ No newline at end of file
+}
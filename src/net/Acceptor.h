@@ -10,6 +10,7 @@ class InetAddress;
 /**
  * Acceptor运行在baseLoop中
  * TcpServer发现Acceptor有一个新连接，则将此channel分发给一个subLoop
+ * (TcpServer::setAcceptPerLoop时每个subLoop各有一个Acceptor，监听同一个地址，由SO_REUSEPORT在内核中分配连接)
  */
 class Acceptor
 {
@@ -24,9 +25,30 @@ public:
         newConnectionCallback_ = cb;
     }
 
+    /**
+     * 监听socket的选项，都要在listen之前设置
+     * backlog：等待accept的连接队列长度
+     * deferAcceptSeconds：大于0时设置TCP_DEFER_ACCEPT，连接上有数据到达以后才唤醒accept
+     * fastOpenQueue：大于0时开启TCP_FASTOPEN
+     * maxAcceptsPerEvent：一次可读事件最多accept的连接数，连接风暴时不用每个连接都回到epoll_wait，
+     * 又不会因为一直有新连接而饿着同一个loop上的其他连接
+     */
+    void setBacklog(int backlog) { backlog_ = backlog; }
+    void setDeferAccept(int seconds) { deferAcceptSeconds_ = seconds; }
+    void setFastOpen(int queueLen) { fastOpenQueue_ = queueLen; }
+    void setMaxAcceptsPerEvent(int n) { maxAcceptsPerEvent_ = n > 0 ? n : 1; }
+
+    EventLoop* getLoop() const { return loop_; }
+
+    // 所属的loop已经退出、EventLoop已经销毁时调用：之后析构不再访问loop(不从poller中移除channel)，
+    // 只关闭监听socket和占位fd
+    void detachLoop();
     bool listenning() const { return listenning_; }
     void listen();
 
+    static const int kDefaultBacklog = 1024;
+    static const int kDefaultMaxAcceptsPerEvent = 64;
+
 private:
     void handleRead();
 
@@ -36,4 +58,8 @@ private:
     NewConnectionCallback newConnectionCallback_;
     bool listenning_;       // 是否正在监听的标志
     int idleFd_;            // 防止连接fd数量超过上线，用于占位的fd
+    int backlog_;
+    int deferAcceptSeconds_;
+    int fastOpenQueue_;
+    int maxAcceptsPerEvent_;
 };
\ No newline at end of file
@@ -31,35 +31,40 @@ const char Buffer::kCRLF[] = "\r\n";
 ssize_t Buffer::readFd(int fd, int *saveErrno)
 {
     // 栈额外空间，用于从套接字往出读时，当buffer_暂时不够用时暂存数据，待buffer_重新分配足够空间后，在把数据交换给buffer_。
-    char extrabuf[65536] = {0};                     // 栈上内存空间 65536/1024 = 64KB
+    // 不需要清零：readv只会写入，后面也只会拷贝readv写入的那一部分
+    char extrabuf[65536];                           // 栈上内存空间 65536/1024 = 64KB
+    return readFd(fd, saveErrno, extrabuf, sizeof(extrabuf));
+}
 
+ssize_t Buffer::readFd(int fd, int *saveErrno, char *spill, size_t spillLen)
+{
     struct iovec vec[2];                            // 使用iovec指向两个缓冲区
     const size_t writable = writableBytes();        // 可写缓冲区大小
 
     // 第一块缓冲区，指向可写空间
     vec[0].iov_base = begin() + writerIndex_;       // 当我们用readv从socket缓冲区读数据，首先会先填满这个vec[0], 也就是我们的Buffer缓冲区
     vec[0].iov_len = writable;
-    // 第二块缓冲区，指向栈空间
-    vec[1].iov_base = extrabuf;                     // 第二块缓冲区，如果Buffer缓冲区都填满了，那就填到我们临时创建的栈空间
-    vec[1].iov_len = sizeof(extrabuf);
+    // 第二块缓冲区，指向溢出区
+    vec[1].iov_base = spill;                        // 第二块缓冲区，如果Buffer缓冲区都填满了，那就填到溢出区
+    vec[1].iov_len = spillLen;
 
-    // 如果Buffer缓冲区大小比extrabuf(64k)还小，那就Buffer和extrabuf都用上
-    // 如果Buffer缓冲区大小比64k还大或等于，那么就只用Buffer。
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
-    const ssize_t n = ::readv(fd, vec, iovcnt);     // Buffer存不下，剩下的存入暂时存入到extrabuf中
+    // 如果Buffer缓冲区大小比溢出区还小，那就Buffer和溢出区都用上
+    // 如果Buffer缓冲区大小比溢出区还大或等于，那么就只用Buffer。
+    const int iovcnt = (writable < spillLen) ? 2 : 1;
+    const ssize_t n = ::readv(fd, vec, iovcnt);     // Buffer存不下，剩下的存入暂时存入到溢出区中
 
     if (n < 0)
     {
         *saveErrno = errno;
     }
-    else if (n <= writable)                         // Buffer的可写缓冲区已经够存储读出来的数据了
+    else if (static_cast<size_t>(n) <= writable)    // Buffer的可写缓冲区已经够存储读出来的数据了
     {
         writerIndex_ += n;
     }
-    else                                            // Buffer存不下，对Buffer扩容，然后把extrabuf中暂存的数据拷贝（追加）到Buffer
+    else                                            // Buffer存不下，对Buffer扩容，然后把溢出区中暂存的数据拷贝（追加）到Buffer
     {
         writerIndex_ = buffer_.size();
-        append(extrabuf, n - writable);             // 根据情况对buffer_扩容 并将extrabuf存储的另一部分数据追加至buffer_
+        append(spill, n - writable);                // 根据情况对buffer_扩容 并将溢出区存储的另一部分数据追加至buffer_
     }
     return n;
 
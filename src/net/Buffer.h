@@ -1,10 +1,15 @@
 #pragma once
 
+#include "ByteSearch.h"
+
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
+#include <stdint.h>
+#include <endian.h>
 
 // 网络库底层的缓冲区类型定义
 /*
@@ -39,6 +44,14 @@ public:
 
     }
 
+    // 交换两个Buffer的存储空间，不拷贝数据。TcpConnection::send(Buffer*)跨线程时用它把调用者的数据整个移交给loop线程
+    void swap(Buffer &rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     size_t readableBytes() const { return writerIndex_ - readerIndex_; }
     size_t writableBytes() const { return buffer_.size() - writerIndex_; }
     size_t prependableBytes() const { return readerIndex_; }
@@ -47,10 +60,36 @@ public:
     const char *peek() const { return begin() + readerIndex_; }
 
     // 查找buffer中是否有"\r\n", 解析http请求行用到
-    const char* findCRLF() const
+    // 下面的查找函数都使用SIMD实现(见ByteSearch.h)，找不到时返回NULL
+    const char* findCRLF() const { return findCRLF(peek()); }
+    // 从start位置开始查找"\r\n"
+    const char* findCRLF(const char* start) const
+    {
+        assert(peek() <= start);
+        assert(start <= beginWrite());
+        return notFoundToNull(bytesearch::findCRLF(start, beginWrite()));
+    }
+
+    // 查找"\n"，按行分割的协议用到
+    const char* findEOL() const { return findEOL(peek()); }
+    const char* findEOL(const char* start) const { return findChar(start, '\n'); }
+
+    // 查找单个字符c
+    const char* findChar(char c) const { return findChar(peek(), c); }
+    const char* findChar(const char* start, char c) const
+    {
+        assert(peek() <= start);
+        assert(start <= beginWrite());
+        return notFoundToNull(bytesearch::findChar(start, beginWrite(), c));
+    }
+
+    // 查找chars中任意一个字符（chars以'\0'结尾，不超过bytesearch::kMaxAnyOf个字符时走SIMD路径）
+    const char* findAnyOf(const char* chars) const { return findAnyOf(peek(), chars); }
+    const char* findAnyOf(const char* start, const char* chars) const
     {
-        const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF+2);
-        return crlf == beginWrite() ? NULL : crlf;
+        assert(peek() <= start);
+        assert(start <= beginWrite());
+        return notFoundToNull(bytesearch::findAnyOf(start, beginWrite(), chars, ::strlen(chars)));
     }
 
     // 一直取到end位置. 在解析请求行的时候从buffer中读取一行后要移动指针便于读取下一行
@@ -114,8 +153,73 @@ public:
     char *beginWrite() { return begin() + writerIndex_; }
     const char *beginWrite() const { return begin() + writerIndex_; }
 
+    // 在可读数据的前面插入数据，使用的是prependable bytes空间（比如在消息前面补上长度头部）
+    void prepend(const void* data, size_t len)
+    {
+        assert(len <= prependableBytes());
+        readerIndex_ -= len;
+        const char* d = static_cast<const char*>(data);
+        std::copy(d, d + len, begin() + readerIndex_);
+    }
+
+    /**
+     * 整数读写辅助函数，Buffer中的整数一律是网络字节序(大端)：
+     * appendIntXX  : 主机字节序转成网络字节序后追加到可读数据的尾部
+     * prependIntXX : 主机字节序转成网络字节序后插入到可读数据的前面(占用kCheapPrepend那部分空间)
+     * peekIntXX    : 读取可读数据开头的整数并转成主机字节序，不移动readerIndex_
+     * readIntXX    : peekIntXX之后再retrieve掉这个整数
+     */
+    void appendInt64(int64_t x) { int64_t be = htobe64(x); append(reinterpret_cast<const char*>(&be), sizeof be); }
+    void appendInt32(int32_t x) { int32_t be = htobe32(x); append(reinterpret_cast<const char*>(&be), sizeof be); }
+    void appendInt16(int16_t x) { int16_t be = htobe16(x); append(reinterpret_cast<const char*>(&be), sizeof be); }
+    void appendInt8(int8_t x) { append(reinterpret_cast<const char*>(&x), sizeof x); }
+
+    void prependInt64(int64_t x) { int64_t be = htobe64(x); prepend(&be, sizeof be); }
+    void prependInt32(int32_t x) { int32_t be = htobe32(x); prepend(&be, sizeof be); }
+    void prependInt16(int16_t x) { int16_t be = htobe16(x); prepend(&be, sizeof be); }
+    void prependInt8(int8_t x) { prepend(&x, sizeof x); }
+
+    int64_t peekInt64() const
+    {
+        assert(readableBytes() >= sizeof(int64_t));
+        int64_t be = 0;
+        ::memcpy(&be, peek(), sizeof be);
+        return be64toh(be);
+    }
+    int32_t peekInt32() const
+    {
+        assert(readableBytes() >= sizeof(int32_t));
+        int32_t be = 0;
+        ::memcpy(&be, peek(), sizeof be);
+        return be32toh(be);
+    }
+    int16_t peekInt16() const
+    {
+        assert(readableBytes() >= sizeof(int16_t));
+        int16_t be = 0;
+        ::memcpy(&be, peek(), sizeof be);
+        return be16toh(be);
+    }
+    int8_t peekInt8() const
+    {
+        assert(readableBytes() >= sizeof(int8_t));
+        return *peek();
+    }
+
+    int64_t readInt64() { int64_t x = peekInt64(); retrieve(sizeof x); return x; }
+    int32_t readInt32() { int32_t x = peekInt32(); retrieve(sizeof x); return x; }
+    int16_t readInt16() { int16_t x = peekInt16(); retrieve(sizeof x); return x; }
+    int8_t readInt8() { int8_t x = peekInt8(); retrieve(sizeof x); return x; }
+
+    void retrieveInt64() { retrieve(sizeof(int64_t)); }
+    void retrieveInt32() { retrieve(sizeof(int32_t)); }
+    void retrieveInt16() { retrieve(sizeof(int16_t)); }
+    void retrieveInt8() { retrieve(sizeof(int8_t)); }
+
     // 从fd上读取数据
     ssize_t readFd(int fd, int *saveErrno);
+    // 从fd上读取数据，Buffer写不下的部分先暂存到调用者提供的spill中(一般是所属EventLoop的公共接收区)
+    ssize_t readFd(int fd, int *saveErrno, char *spill, size_t spillLen);
     // 通过fd发送数据
     ssize_t writeFd(int fd, int *saveErrno);
 
@@ -125,6 +229,8 @@ private:
     char* begin() { return &*buffer_.begin(); }     // 先调用begin()返回buffer_的首个元素的迭代器，然后再解引用得到这个变量的，再取地址，得到这个变量的首地址。   
     const char* begin() const { return &*buffer_.begin(); }
 
+    const char* notFoundToNull(const char* pos) const { return pos == beginWrite() ? NULL : pos; }
+
     void makeSpace(size_t len)                      // 调整可写的空间
     {
         /**
@@ -0,0 +1,309 @@
+#include "ByteSearch.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BYTESEARCH_X86 1
+#endif
+
+namespace bytesearch
+{
+
+/***************************** 逐字节比较的实现 *****************************/
+namespace scalar
+{
+
+const char* findCRLF(const char *begin, const char *end)
+{
+    for (const char *p = begin; p + 1 < end; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n')
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char* findChar(const char *begin, const char *end, char c)
+{
+    for (const char *p = begin; p < end; ++p)
+    {
+        if (*p == c)
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n)
+{
+    for (const char *p = begin; p < end; ++p)
+    {
+        if (::memchr(chars, *p, n) != nullptr)
+        {
+            return p;
+        }
+    }
+    return end;
+}
+
+} // namespace scalar
+
+#ifdef BYTESEARCH_X86
+/********************************* SSE2 ************************************/
+namespace sse2
+{
+
+const char* findCRLF(const char *begin, const char *end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const char *p = begin;
+    // 同时加载p和p+1开始的16字节，p[i]=='\r'且p[i+1]=='\n'的位置就是CRLF
+    for (; p + 16 < end; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalar::findCRLF(p, end);
+}
+
+const char* findChar(const char *begin, const char *end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    const char *p = begin;
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalar::findChar(p, end, c);
+}
+
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n)
+{
+    if (n > static_cast<size_t>(kMaxAnyOf))
+    {
+        return scalar::findAnyOf(begin, end, chars, n);
+    }
+    __m128i needles[kMaxAnyOf];
+    for (size_t i = 0; i < n; ++i)
+    {
+        needles[i] = _mm_set1_epi8(chars[i]);
+    }
+    const char *p = begin;
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i hit = _mm_setzero_si128();
+        for (size_t i = 0; i < n; ++i)
+        {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, needles[i]));
+        }
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return scalar::findAnyOf(p, end, chars, n);
+}
+
+} // namespace sse2
+
+/********************************* AVX2 ************************************/
+namespace avx2
+{
+
+// 尾部不足32字节的部分也在AVX2函数内部处理（先16字节一组，再逐字节），不去调用SSE版本：
+// ymm寄存器高位是脏的时候执行非VEX编码的SSE指令，有的CPU(以及虚拟机)上会有很大的状态切换开销，
+// 而在target("avx2")的函数里面_mm_*指令都会被编码成VEX指令
+__attribute__((target("avx2"), always_inline))
+inline const char* tailCRLF(const char *p, const char *end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    for (; p + 16 < end; p += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    for (; p + 1 < end; ++p)
+    {
+        if (p[0] == '\r' && p[1] == '\n') return p;
+    }
+    return end;
+}
+
+__attribute__((target("avx2"), always_inline))
+inline const char* tailChar(const char *p, const char *end, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    for (; p + 16 <= end; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle));
+        if (mask != 0) return p + __builtin_ctz(mask);
+    }
+    for (; p < end; ++p)
+    {
+        if (*p == c) return p;
+    }
+    return end;
+}
+
+__attribute__((target("avx2")))
+const char* findCRLF(const char *begin, const char *end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    const char *p = begin;
+    for (; p + 32 < end; p += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf))));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return tailCRLF(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* findChar(const char *begin, const char *end, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    const char *p = begin;
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return tailChar(p, end, c);
+}
+
+__attribute__((target("avx2")))
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n)
+{
+    if (n > static_cast<size_t>(kMaxAnyOf))
+    {
+        return scalar::findAnyOf(begin, end, chars, n);
+    }
+    __m256i needles[kMaxAnyOf];
+    for (size_t i = 0; i < n; ++i)
+    {
+        needles[i] = _mm256_set1_epi8(chars[i]);
+    }
+    const char *p = begin;
+    for (; p + 32 <= end; p += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i hit = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; ++i)
+        {
+            hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, needles[i]));
+        }
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hit));
+        if (mask != 0)
+        {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    for (; p < end; ++p)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (*p == chars[i]) return p;
+        }
+    }
+    return end;
+}
+
+} // namespace avx2
+#endif // BYTESEARCH_X86
+
+/******************************** 运行时分发 ********************************/
+namespace
+{
+
+struct Dispatch
+{
+    const char* (*findCRLF)(const char*, const char*);
+    const char* (*findChar)(const char*, const char*, char);
+    const char* (*findAnyOf)(const char*, const char*, const char*, size_t);
+    const char *name;
+};
+
+Dispatch selectImplementation()
+{
+#ifdef BYTESEARCH_X86
+    __builtin_cpu_init();   // 静态初始化阶段调用__builtin_cpu_supports之前必须先初始化
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Dispatch{ avx2::findCRLF, avx2::findChar, avx2::findAnyOf, "avx2" };
+    }
+    return Dispatch{ sse2::findCRLF, sse2::findChar, sse2::findAnyOf, "sse2" };
+#else
+    return Dispatch{ scalar::findCRLF, scalar::findChar, scalar::findAnyOf, "scalar" };
+#endif
+}
+
+// 程序启动时选择一次，之后每次调用只是一次间接跳转
+const Dispatch g_dispatch = selectImplementation();
+
+} // namespace
+
+// 不足一个向量宽度的短区间(比如很短的请求头)直接逐字节比较，省掉一次间接调用
+const ptrdiff_t kShortRange = 16;
+
+const char* findCRLF(const char *begin, const char *end)
+{
+    if (end - begin <= kShortRange)
+    {
+        return scalar::findCRLF(begin, end);
+    }
+    return g_dispatch.findCRLF(begin, end);
+}
+
+const char* findChar(const char *begin, const char *end, char c)
+{
+    if (end - begin < kShortRange)
+    {
+        return scalar::findChar(begin, end, c);
+    }
+    return g_dispatch.findChar(begin, end, c);
+}
+
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n)
+{
+    return g_dispatch.findAnyOf(begin, end, chars, n);
+}
+
+const char* implementation()
+{
+    return g_dispatch.name;
+}
+
+} // namespace bytesearch
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * 在[begin, end)中查找分隔符，找不到时返回end。
+ * x86-64上使用SSE2(所有x86-64 CPU都支持)，运行时检测到AVX2则使用AVX2，其他平台使用逐字节比较的版本。
+ * Buffer::findCRLF/findEOL/findChar/findAnyOf以及HttpContext解析请求时都是用的这里的函数
+ */
+namespace bytesearch
+{
+
+// 查找"\r\n"，返回'\r'所在的位置
+const char* findCRLF(const char *begin, const char *end);
+
+// 查找字符c第一次出现的位置
+const char* findChar(const char *begin, const char *end, char c);
+
+// 查找chars中任意一个字符第一次出现的位置，chars的长度为n (n <= kMaxAnyOf时走SIMD路径)
+const int kMaxAnyOf = 8;
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n);
+
+// 当前使用的实现名称："avx2"、"sse2" 或者 "scalar"，便于日志和测试输出
+const char* implementation();
+
+// 逐字节比较的实现，供性能测试对比以及非x86平台使用
+namespace scalar
+{
+const char* findCRLF(const char *begin, const char *end);
+const char* findChar(const char *begin, const char *end, char c);
+const char* findAnyOf(const char *begin, const char *end, const char *chars, size_t n);
+}
+
+} // namespace bytesearch
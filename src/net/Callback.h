@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <functional>
+#include <string>
 
 class Buffer;
 class TcpConnection;
@@ -12,9 +13,17 @@ using ConnectionCallback = std::function<void(const TcpConnectionPtr &)>;
 using CloseCallback = std::function<void(const TcpConnectionPtr &)>;
 using WriteCompleteCallback = std::function<void(const TcpConnectionPtr &)>;
 using HighWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
+using LowWaterMarkCallback = std::function<void(const TcpConnectionPtr &, size_t)>;
 
 using MessageCallback = std::function<void(const TcpConnectionPtr &, Buffer *, Timestamp)>;
 
+// 引用计数的只读消息体，同一份数据可以同时排在多个连接的发送队列中，不需要为每个连接各拷贝一次
+using PayloadPtr = std::shared_ptr<const std::string>;
+inline PayloadPtr makePayload(std::string &&data) { return std::make_shared<const std::string>(std::move(data)); }
+inline PayloadPtr makePayload(const char *data, size_t len) { return std::make_shared<const std::string>(data, len); }
+// 持有一块只读内存的任意对象(PayloadPtr、移交给loop的Buffer等)，发送队列通过它保证内存在发送完之前不会被释放
+using DataHolder = std::shared_ptr<const void>;
+
 
 void defaultConnectionCallback(const TcpConnectionPtr& conn);
 void defaultMessageCallback(const TcpConnectionPtr& conn, Buffer* buffer, Timestamp receiveTime);
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "ChainBuffer.h"
+
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+
+namespace
+{
+
+// 每次readFd额外准备的slab个数，加上尾slab剩余空间，一次readv最多可以读 4*16KB
+const int kReadSlabs = 4;
+// 一次writev最多携带的slab个数
+const int kMaxWriteIov = 64;
+// 每个线程的slab池最多缓存的空闲slab个数（256 * 16KB = 4MB），多出来的直接还给系统
+const size_t kMaxPooledSlabs = 256;
+
+/**
+ * 线程局部的slab池。一个连接的缓冲区基本只在它所属的loop线程中使用，因此每个线程各自缓存
+ * 空闲slab即可，不需要加锁。连接在别的线程析构时，slab会进入那个线程的池中，同样是安全的
+ */
+class SlabPool
+{
+public:
+    ~SlabPool()
+    {
+        for (char *slab : freeSlabs_)
+        {
+            delete[] slab;
+        }
+    }
+
+    char* get()
+    {
+        if (freeSlabs_.empty())
+        {
+            return new char[ChainBuffer::kSlabSize];    // 不需要初始化
+        }
+        char *slab = freeSlabs_.back();
+        freeSlabs_.pop_back();
+        return slab;
+    }
+
+    void put(char *slab)
+    {
+        if (freeSlabs_.size() < kMaxPooledSlabs)
+        {
+            freeSlabs_.push_back(slab);
+        }
+        else
+        {
+            delete[] slab;
+        }
+    }
+
+private:
+    std::vector<char*> freeSlabs_;
+};
+
+thread_local SlabPool t_slabPool;
+
+} // namespace
+
+const size_t ChainBuffer::kSlabSize;
+
+ChainBuffer::ChainBuffer()
+    : readable_(0)
+{
+}
+
+ChainBuffer::~ChainBuffer()
+{
+    for (const Segment &seg : segments_)
+    {
+        releaseSegment(seg);
+    }
+}
+
+void ChainBuffer::releaseSegment(const Segment &seg)
+{
+    if (seg.isFile())
+    {
+        ::close(seg.fd);
+    }
+    else if (seg.isSlab())
+    {
+        t_slabPool.put(seg.data);
+    }
+}
+
+const char* ChainBuffer::peek() const
+{
+    if (readable_ == 0 || segments_.front().isFile())
+    {
+        return nullptr;
+    }
+    const Segment &seg = segments_.front();
+    return seg.data + seg.readIndex;
+}
+
+size_t ChainBuffer::contiguousBytes() const
+{
+    if (readable_ == 0 || segments_.front().isFile())
+    {
+        return 0;
+    }
+    return segments_.front().readable();
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    if (len >= readable_)
+    {
+        retrieveAll();
+        return;
+    }
+    readable_ -= len;
+    while (len > 0)
+    {
+        Segment &seg = segments_.front();
+        size_t n = std::min(len, seg.readable());
+        seg.readIndex += n;
+        len -= n;
+        // 首段中的数据已经全部取完，并且后面还有数据，则归还这个slab(文件段则关闭fd)
+        // (最后一个slab保留下来，后续的append可以继续使用它剩余的空间)
+        if (seg.readable() == 0 && (segments_.size() > 1 || !seg.isSlab()))
+        {
+            releaseSegment(seg);
+            segments_.pop_front();
+        }
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    // 只保留一个slab并复位，其他slab全部归还，文件段全部关闭
+    char *keep = nullptr;
+    for (const Segment &seg : segments_)
+    {
+        if (keep == nullptr && seg.isSlab())
+        {
+            keep = seg.data;
+        }
+        else
+        {
+            releaseSegment(seg);
+        }
+    }
+    segments_.clear();
+    if (keep != nullptr)
+    {
+        pushSlab(keep);
+    }
+    readable_ = 0;
+}
+
+std::string ChainBuffer::retrieveAsString(size_t len)
+{
+    len = std::min(len, readable_);
+    std::string result;
+    result.reserve(len);
+    size_t left = len;
+    for (const Segment &seg : segments_)
+    {
+        if (left == 0) break;
+        size_t n = std::min(left, seg.readable());
+        if (seg.isFile())
+        {
+            // 文件段的数据不在内存中，只能从文件中读出来
+            size_t old = result.size();
+            result.resize(old + n);
+            ssize_t got = ::pread(seg.fd, &result[old], n, seg.fileOffset + seg.readIndex);
+            result.resize(old + (got > 0 ? got : 0));
+        }
+        else
+        {
+            result.append(seg.data + seg.readIndex, n);
+        }
+        left -= n;
+    }
+    retrieve(len);
+    return result;
+}
+
+size_t ChainBuffer::tailWritable() const
+{
+    if (segments_.empty() || !segments_.back().isSlab())
+    {
+        return 0;
+    }
+    return kSlabSize - segments_.back().writeIndex;
+}
+
+void ChainBuffer::pushSlab(char *slab)
+{
+    segments_.push_back(Segment{slab, 0, 0, -1, 0, DataHolder()});
+}
+
+void ChainBuffer::append(const char *data, size_t len)
+{
+    readable_ += len;
+    while (len > 0)
+    {
+        if (tailWritable() == 0)
+        {
+            pushSlab(t_slabPool.get());
+        }
+        Segment &tail = segments_.back();
+        size_t n = std::min(len, kSlabSize - tail.writeIndex);
+        ::memcpy(tail.data + tail.writeIndex, data, n);
+        tail.writeIndex += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::dropEmptySlab()
+{
+    // 缓冲区为空时保留下来的那个空slab，在挂文件段或引用段之前先还回去，保证首段总是有数据的
+    if (readable_ == 0)
+    {
+        for (const Segment &seg : segments_)
+        {
+            releaseSegment(seg);
+        }
+        segments_.clear();
+    }
+}
+
+void ChainBuffer::appendRef(const DataHolder &holder, const char *data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    dropEmptySlab();
+    // 引用段只会被读取(writev/send)，不会写入
+    segments_.push_back(Segment{const_cast<char*>(data), 0, len, -1, 0, holder});
+    readable_ += len;
+}
+
+void ChainBuffer::appendPayload(const PayloadPtr &payload, size_t offset)
+{
+    if (payload && offset < payload->size())
+    {
+        appendRef(payload, payload->data() + offset, payload->size() - offset);
+    }
+}
+
+void ChainBuffer::appendString(std::string &&str, size_t offset)
+{
+    if (offset >= str.size())
+    {
+        return;
+    }
+    const size_t len = str.size() - offset;
+    if (len <= tailWritable())
+    {
+        append(str.data() + offset, len);
+        return;
+    }
+    dropEmptySlab();
+    segments_.push_back(Segment{nullptr, offset, str.size(), -1, 0, DataHolder(), std::move(str)});
+    Segment &seg = segments_.back();
+    seg.data = &seg.owned[0];
+    readable_ += len;
+}
+
+void ChainBuffer::appendFile(int fd, off_t offset, size_t len)
+{
+    if (len == 0)
+    {
+        ::close(fd);
+        return;
+    }
+    dropEmptySlab();
+    segments_.push_back(Segment{nullptr, 0, len, fd, offset, DataHolder()});
+    readable_ += len;
+}
+
+/**
+ * vec[0]指向尾slab剩余的空间，其余的iovec指向从slab池中取出的新slab，
+ * 读到了数据的新slab挂到链表尾部，没用上的slab再还给slab池
+ */
+ssize_t ChainBuffer::readFd(int fd, int *saveErrno)
+{
+    struct iovec vec[kReadSlabs + 1];
+    char *fresh[kReadSlabs];
+    int iovcnt = 0;
+
+    const size_t writable = tailWritable();
+    if (writable > 0)
+    {
+        Segment &tail = segments_.back();
+        vec[iovcnt].iov_base = tail.data + tail.writeIndex;
+        vec[iovcnt].iov_len = writable;
+        ++iovcnt;
+    }
+    for (int i = 0; i < kReadSlabs; ++i)
+    {
+        fresh[i] = t_slabPool.get();
+        vec[iovcnt].iov_base = fresh[i];
+        vec[iovcnt].iov_len = kSlabSize;
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+
+    size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+    readable_ += left;
+    if (writable > 0)
+    {
+        size_t used = std::min(left, writable);
+        segments_.back().writeIndex += used;
+        left -= used;
+    }
+    for (int i = 0; i < kReadSlabs; ++i)
+    {
+        if (left > 0)
+        {
+            size_t used = std::min(left, kSlabSize);
+            segments_.push_back(Segment{fresh[i], 0, used, -1, 0, DataHolder()});
+            left -= used;
+        }
+        else
+        {
+            t_slabPool.put(fresh[i]);
+        }
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int *saveErrno)
+{
+    if (readable_ == 0)
+    {
+        return 0;
+    }
+    if (segments_.front().isFile())
+    {
+        return sendFileSegment(fd, saveErrno);
+    }
+
+    // 收集文件段之前的所有slab和引用段，一次writev发送出去
+    struct iovec vec[kMaxWriteIov];
+    int iovcnt = 0;
+    for (const Segment &seg : segments_)
+    {
+        if (iovcnt == kMaxWriteIov || seg.isFile()) break;
+        if (seg.readable() == 0) continue;
+        vec[iovcnt].iov_base = seg.data + seg.readIndex;
+        vec[iovcnt].iov_len = seg.readable();
+        ++iovcnt;
+    }
+
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFdZeroCopy(int fd, int *saveErrno, size_t minLen, DataHolder *pinned)
+{
+    pinned->reset();
+    if (readable_ > 0)
+    {
+        const Segment &seg = segments_.front();
+        if (seg.isRef() && seg.readable() >= minLen)
+        {
+            ssize_t n = ::send(fd, seg.data + seg.readIndex, seg.readable(), MSG_ZEROCOPY);
+            if (n > 0)
+            {
+                *pinned = seg.holder;
+                return n;
+            }
+            // ENOBUFS：超过了optmem的限制，内核暂时不能再锁定更多的页，这一次退回普通的拷贝发送
+            if (n < 0 && errno != ENOBUFS)
+            {
+                *saveErrno = errno;
+                return n;
+            }
+        }
+    }
+    return writeFd(fd, saveErrno);
+}
+
+ssize_t ChainBuffer::sendFileSegment(int fd, int *saveErrno)
+{
+    const Segment &seg = segments_.front();
+    off_t offset = seg.fileOffset + static_cast<off_t>(seg.readIndex);
+    ssize_t n = ::sendfile(fd, seg.fd, &offset, seg.readable());
+    if (n < 0)
+    {
+        *saveErrno = errno;
+    }
+    else if (n == 0)
+    {
+        // 文件的实际长度比要发送的短，剩下的数据永远也发不出去了
+        *saveErrno = EIO;
+        n = -1;
+    }
+    return n;
+}
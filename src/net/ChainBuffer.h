@@ -0,0 +1,110 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callback.h"
+
+#include <deque>
+#include <string>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * 由固定大小slab串成的链式缓冲区，对外接口与Buffer保持一致（peek/retrieve/append/readFd/writeFd）
+ *
+ * +--------------------+      +--------------------+      +--------------------+
+ * | xxx |   readable   | ---> |      readable      | ---> | readable | writable|
+ * +--------------------+      +--------------------+      +--------------------+
+ *       ^ 首个slab的readIndex                                        ^ 尾slab的writeIndex
+ *
+ * 与Buffer的区别：
+ * 1. Buffer空间不够时会memmove或者resize(拷贝全部数据)，ChainBuffer只是在尾部再挂一个slab，已缓存的数据永远不会被搬动
+ * 2. writeFd用writev一次把多个slab的数据发送出去
+ * 3. 已经取完的slab会立刻归还给本线程的slab池，下次append/readFd直接复用，不用重新向系统申请内存
+ *
+ * 注意：数据在内存上不一定连续，peek()只返回首个slab中的可读数据，连续的长度由contiguousBytes()给出，
+ * 因此TcpConnection只把它用作发送缓冲区(outputBuffer_)，接收缓冲区仍然是要求数据连续的Buffer
+ *
+ * 除了slab，链表中还可以挂文件段(appendFile)，文件段中的数据不进入用户内存，writeFd发送到文件段时
+ * 使用sendfile直接由内核从文件拷贝到socket。各段按照加入的顺序发送，readableBytes()包含文件段的长度
+ *
+ * 还可以挂引用段(appendRef/appendPayload)，引用段直接指向别处的只读数据，不拷贝，只持有数据所有者(DataHolder)
+ * 的一份引用计数，与slab一起由writev发送；以及字符串段(appendString)，直接接管一个std::string，既不拷贝也不申请内存
+ */
+class ChainBuffer : noncopyable
+{
+public:
+    static const size_t kSlabSize = 16 * 1024;     // 每个slab的大小 16KB
+
+    ChainBuffer();
+    ~ChainBuffer();
+
+    size_t readableBytes() const { return readable_; }
+    // 返回首个slab中可读数据的起始地址，缓冲区为空或者首段是文件段时返回nullptr
+    const char* peek() const;
+    // 从peek()开始在内存上连续的可读字节数
+    size_t contiguousBytes() const;
+    // 当前挂着的段(slab、引用段和文件段)的个数
+    size_t slabCount() const { return segments_.size(); }
+
+    // 取出len字节的数据，可以跨越多个slab，取空的slab会被归还给slab池
+    void retrieve(size_t len);
+    void retrieveAll();
+
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+    std::string retrieveAsString(size_t len);
+
+    void append(const std::string &str) { append(str.data(), str.size()); }
+    // 把[data, data+len]追加到尾slab，尾slab写满了就从slab池再取一个挂到尾部
+    void append(const char *data, size_t len);
+
+    // 追加一个引用段：引用[data, data+len)，不拷贝，这块内存由holder负责保持有效
+    void appendRef(const DataHolder &holder, const char *data, size_t len);
+    // 追加一个引用段：引用payload中从offset开始到结尾的数据
+    void appendPayload(const PayloadPtr &payload, size_t offset = 0);
+
+    // 接管str，追加其中从offset开始到结尾的数据：放得进尾slab时直接拷贝，否则把str移进一个字符串段
+    void appendString(std::string &&str, size_t offset = 0);
+
+    // 追加一个文件段：文件fd中从offset开始的len字节。ChainBuffer接管fd，这一段发送完(或者被丢弃)时关闭fd
+    void appendFile(int fd, off_t offset, size_t len);
+
+    // 从fd上读取数据，先读满尾slab剩余的空间，然后读入新取出的slab
+    ssize_t readFd(int fd, int *saveErrno);
+    // 首段在内存中时，使用writev把文件段之前的所有slab和引用段一次发送出去；首段是文件段时，使用sendfile发送这个文件段
+    // 文件提前结束(被截断)时返回-1，*saveErrno为EIO
+    ssize_t writeFd(int fd, int *saveErrno);
+    // 首段是不少于minLen字节的引用段时，用MSG_ZEROCOPY发送这一段，*pinned返回这一段的holder，
+    // 调用者必须持有它直到内核通知发送完成；其他情况(以及内核拒绝零拷贝时)与writeFd相同，*pinned为空
+    ssize_t writeFdZeroCopy(int fd, int *saveErrno, size_t minLen, DataHolder *pinned);
+
+private:
+    struct Segment
+    {
+        char *data;             // slab的首地址，引用段为所引用数据的首地址(只读)，文件段为nullptr
+        size_t readIndex;       // slab中可读数据的起始位置（文件段：已经发送的字节数）
+        size_t writeIndex;      // slab中可写空间的起始位置（文件段：这一段的总长度）
+        int fd;                 // 文件段的文件描述符，其他段为-1
+        off_t fileOffset;       // 文件段在文件中的起始偏移
+        DataHolder holder;      // 引用段所引用数据的所有者
+        std::string owned;      // 字符串段接管的数据，data指向它的内容(deque在两端增删元素不会移动已有的元素)
+
+        bool isFile() const { return fd >= 0; }
+        bool isRef() const { return holder != nullptr; }
+        bool isString() const { return !owned.empty(); }
+        bool isSlab() const { return !isFile() && !isRef() && !isString(); }
+        size_t readable() const { return writeIndex - readIndex; }
+    };
+
+    // 尾slab还能写多少字节（尾部是文件段或引用段时为0）
+    size_t tailWritable() const;
+    // 在尾部挂一个新的空slab
+    void pushSlab(char *slab);
+    // 缓冲区为空时归还保留的空slab，挂非slab段之前调用
+    void dropEmptySlab();
+    // 归还slab或者关闭文件段的fd（引用段出队时自动释放引用计数）
+    static void releaseSegment(const Segment &seg);
+    ssize_t sendFileSegment(int fd, int *saveErrno);
+
+    std::deque<Segment> segments_;
+    size_t readable_;           // 所有段中可读数据的总和
+};
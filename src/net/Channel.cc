@@ -7,6 +7,7 @@
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
 const int Channel::kWriteEvent = EPOLLOUT;
+const int Channel::kEdgeTriggered = EPOLLET;
 
 Channel::Channel(EventLoop *loop, int fd)
     : loop_(loop)
@@ -14,6 +15,7 @@ Channel::Channel(EventLoop *loop, int fd)
     , events_(0)
     , revents_(0)
     , index_(-1)
+    , name_(nullptr)
     , tied_(false)
 {
 
@@ -21,7 +23,7 @@ Channel::Channel(EventLoop *loop, int fd)
 
 Channel::~Channel()
 {
-    if (loop_->isInLoopThread())
+    if (loop_ != nullptr && loop_->isInLoopThread())
     {
         assert(!loop_->hasChannel(this));
     }
@@ -76,32 +78,55 @@ void Channel::handleEvent(Timestamp receiveTime)
 }
 
 
+// 开启了统计时返回记录type类回调耗时的直方图
+static LatencyHistogram* callbackTiming(EventLoop *loop, EventLoopStats::CallbackType type)
+{
+    EventLoopStats &stats = loop->stats();
+    return stats.enabled() ? &stats.callback(type) : nullptr;
+}
+
 // 根据相应事件执行回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {
     // 对方关闭连接会触发EPOLLHUP，此时需要关闭连接
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
     {
-        if (closeCallback_) closeCallback_();
+        if (closeCallback_)
+        {
+            ScopedLatency timing(callbackTiming(loop_, EventLoopStats::kCloseCallback));
+            closeCallback_();
+        }
     }
 
     // 错误事件
     if (revents_ & EPOLLERR)
     {
-        if (errorCallback_) errorCallback_();
+        if (errorCallback_)
+        {
+            ScopedLatency timing(callbackTiming(loop_, EventLoopStats::kErrorCallback));
+            errorCallback_();
+        }
     }
 
     // EPOLLIN表示普通数据和优先数据可读，EPOLLPRI表示高优先数据可读，EPOLLRDHUP表示TCP连接对方关闭或者对方关闭写端
     // (个人感觉只需要EPOLLIN就行），则处理可读事件
     if (revents_ & (EPOLLIN | EPOLLPRI | EPOLLRDHUP))
     {
-        if (readCallback_) readCallback_(receiveTime);
+        if (readCallback_)
+        {
+            ScopedLatency timing(callbackTiming(loop_, EventLoopStats::kReadCallback));
+            readCallback_(receiveTime);
+        }
     }
 
     // 写事件发生，处理可写事件
     if (revents_ & EPOLLOUT)
     {
-        if (writeCallback_) writeCallback_();
+        if (writeCallback_)
+        {
+            ScopedLatency timing(callbackTiming(loop_, EventLoopStats::kWriteCallback));
+            writeCallback_();
+        }
     }
 
 }
\ No newline at end of file
@@ -3,10 +3,12 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "Logging.h"
+#include "InlineFunction.h"
 
 
 #include <functional>
 #include <memory>
+#include <string>
 
 class EventLoop;
 
@@ -17,8 +19,8 @@ class EventLoop;
 class Channel : noncopyable
 {
 public:
-    using EventCallback = std::function<void()>;
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    using EventCallback = InlineFunction<void()>;
+    using ReadEventCallback = InlineFunction<void(Timestamp)>;
     // Channel要管理fd，而且还需要知道自己属于哪个loop，因此初始化需要知道fd和loop
     Channel(EventLoop *loop, int fd);
     ~Channel();
@@ -39,6 +41,7 @@ public:
     int fd() const { return fd_; }                    // 返回封装的fd
     int events() const { return events_; }            // 返回感兴趣的事件
     void set_revents(int revt) { revents_ = revt; }  // 设置Poller返回的发生事件
+    int revents() const { return revents_; }         // Poller最近一次返回的事件
 
     // 向epoll中注册、删除fd感兴趣的事件，update()其本质调用epoll_ctl
     void enableReading() { events_ |= kReadEvent; update(); }
@@ -46,6 +49,12 @@ public:
     void enableWriting() { events_ |= kWriteEvent; update(); }
     void disableWriting() { events_ &= ~kWriteEvent; update(); }
     void disableAll() { events_ &= kNoneEvent; update(); }
+    /**
+     * 切换到边沿触发：之后的注册都带上EPOLLET，并且一直关注可写事件，由使用者自己记录是否有数据在等待发送。
+     * 只改变events_，需要在第一次enableReading之前调用，只有EPollPoller支持(见Poller::supportsEdgeTriggered)
+     */
+    void setEdgeTriggered() { events_ |= kEdgeTriggered | kWriteEvent; }
+    bool isEdgeTriggered() const { return events_ & kEdgeTriggered; }
 
     // 返回fd当前的事件状态
     bool isNoneEvent() const { return events_ == kNoneEvent; }
@@ -62,8 +71,15 @@ public:
     int index() { return index_; }
     void set_index(int idx) { index_ = idx; }
 
+    // channel的名字(例如连接名)，看门狗报告卡住的回调时使用(见LoopWatchdog)。
+    // 只保存指针，指向的字符串要和Channel活得一样久
+    void setName(const std::string *name) { name_ = name; }
+    const std::string* name() const { return name_; }
+
     // 返回Channel自己所属的loop
     EventLoop* ownerLoop() { return loop_; }
+    // 所属的loop已经退出并销毁(poller也已经不存在)时调用，之后不能再update/remove，析构时也不再访问loop
+    void detachLoop() { loop_ = nullptr; }
     // 从EPoller中移除自己，也就是让EPoller停止关注自己感兴趣的事件，
     // 这个移除不是销毁Channel，而是只改变channel的状态，即index_,
     // Channel的生命周期和TcpConnection一样长，因为Channel是TcpConnection的成员，
@@ -78,10 +94,12 @@ private:
      * const int Channel::kNoneEvent = 0;
      * const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
      * const int Channel::kWriteEvent = EPOLLOUT;
+     * const int Channel::kEdgeTriggered = EPOLLET;
      */
     static const int kNoneEvent;
     static const int kReadEvent;
     static const int kWriteEvent;
+    static const int kEdgeTriggered;
 
     EventLoop *loop_;           // 当前Channel属于的EventLoop
     const int fd_;              // fd, Poller监听对象
@@ -89,6 +107,8 @@ private:
     int revents_;               // poller返回的具体发生的事件
     int index_;                 // 在EPoller上注册的状态（状态有kNew,kAdded, kDeleted）
 
+    const std::string *name_;   // 可以为空
+
     std::weak_ptr<void> tie_;   // 弱指针指向TcpConnection(必要时升级为shared_ptr多一份引用计数，避免用户误删)
     bool tied_;                 // 标志此 Channel 是否被调用过 Channel::tie 方法
 
@@ -11,9 +11,10 @@ const int kAdded = 1;                           // 某个channel已经添加至E
 const int kDeleted = 2;                         // 某个channel已经从EPoller删除
 
 EPollPoller::EPollPoller(EventLoop *loop)
-    : ownerLoop_(loop)                          // 记录EPollPoller属于哪个EventLoop
+    : Poller(loop)                              // 记录EPollPoller属于哪个EventLoop
     , epollfd_(::epoll_create1(EPOLL_CLOEXEC))
     , events_(kInitEventListSize)
+    , channels_(kInitChannelTableSize, ChannelSlot{nullptr, 0})
 {
     if (epollfd_ < 0)
     {
@@ -34,7 +35,9 @@ EPollPoller::~EPollPoller()
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
     // epoll_wait把检测到的事件都存储在events_数组中
-    size_t numEvents = ::epoll_wait(epollfd_, &(*events_.begin()), static_cast<int>(events_.size()), timeoutMs);
+    // 返回值可能是-1，不能用无符号数保存
+    int numEvents = ::epoll_wait(epollfd_, &(*events_.begin()), static_cast<int>(events_.size()), timeoutMs);
+    ++syscalls_;
     int saveErrno = errno;
     Timestamp now(Timestamp::now());
     // 有事件产生
@@ -42,7 +45,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
     {
         fillActiveChannels(numEvents, activeChannels); // 填充活跃的channels
         // 对events_进行扩容操作
-        if (numEvents == events_.size())
+        if (static_cast<size_t>(numEvents) == events_.size())
         {
             events_.resize(events_.size() * 2);
         }
@@ -74,15 +77,16 @@ void EPollPoller::updateChannel(Channel *channel)
     // 未添加状态和已删除状态都有可能会被再次添加到epoll中
     if (index == kNew || index == kDeleted)
     {
-        int fd = channel->fd();
+        ChannelSlot &entry = slot(channel->fd());
         if (index == kNew)
         {
-            channels_[fd] = channel;      /// 添加到键值对 
+            // 新的channel占用这个fd，换一个编号，之前的channel遗留的事件都会被识别出来
+            entry.channel = channel;
+            ++entry.gen;
         }
         else // index == kDeleted
         {
-            assert(channels_.find(fd) != channels_.end());   // 这个处于kDeleted的channel还在channels_中，则继续执行
-            assert(channels_[fd] == channel);                // channels_中记录的该fd对应的channel没有发生变化，则继续执行
+            assert(entry.channel == channel);   // 这个处于kDeleted的channel还在channels_中，并且fd对应的channel没有发生变化
         }
         // 修改channel的状态，此时是已添加状态
         channel->set_index(kAdded);
@@ -110,10 +114,12 @@ void EPollPoller::updateChannel(Channel *channel)
 // 这个移除指的是EPoller再检测该channel上是否有事件发生了
 void EPollPoller::removeChannel(Channel *channel)
 {
-    // 从Map中删除
+    // 从表中删除
     int fd = channel->fd();
-    channels_.erase(fd); 
-
+    if (static_cast<size_t>(fd) < channels_.size() && channels_[fd].channel == channel)
+    {
+        channels_[fd].channel = nullptr;
+    }
 
     int index = channel->index();
     if (index == kAdded)
@@ -125,24 +131,47 @@ void EPollPoller::removeChannel(Channel *channel)
     channel->set_index(kNew);
 }
 
-
-// 判断参数channel是否在当前poller当中
 bool EPollPoller::hasChannel(Channel *channel) const
 {
-    // 可以在map中找到该fd（键），并且it->second==channel（值）
-    auto it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    int fd = channel->fd();
+    return static_cast<size_t>(fd) < channels_.size() && channels_[fd].channel == channel;
 }
 
+EPollPoller::ChannelSlot& EPollPoller::slot(int fd)
+{
+    if (static_cast<size_t>(fd) >= channels_.size())
+    {
+        size_t size = channels_.size() * 2;
+        while (size <= static_cast<size_t>(fd))
+        {
+            size *= 2;
+        }
+        channels_.resize(size, ChannelSlot{nullptr, 0});
+    }
+    return channels_[fd];
+}
 
 void EPollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels) const
 {
     for (int i = 0; i < numEvents; ++i)
     {
-        // 获得events_对应的channel，并把events_[i].events赋值给该channel中用于记录实际发生事件的属性revents_
-        Channel *channel = static_cast<Channel*>(events_[i].data.ptr);
-        channel->set_revents(events_[i].events);
-        activeChannels->push_back(channel);
+        // data.u64中是注册时的gen和fd，见ChannelSlot
+        uint64_t data = events_[i].data.u64;
+        int fd = static_cast<int>(data & 0xffffffff);
+        uint32_t gen = static_cast<uint32_t>(data >> 32);
+        if (static_cast<size_t>(fd) >= channels_.size())
+        {
+            continue;
+        }
+        const ChannelSlot &entry = channels_[fd];
+        if (entry.channel == nullptr || entry.gen != gen)
+        {
+            LOG_DEBUG << "EPollPoller drops stale event on fd=" << fd;
+            continue;
+        }
+        // 把events_[i].events赋值给该channel中用于记录实际发生事件的属性revents_
+        entry.channel->set_revents(events_[i].events);
+        activeChannels->push_back(entry.channel);
     }
 }
 
@@ -153,10 +182,11 @@ void EPollPoller::update(int operation, Channel *channel)
 
     int fd = channel->fd();
     event.events = channel->events();
-    // 把channel的地址给event.data.ptr，便于调用epoll_wait的时候能够从events_中得知是哪个channel发生的事件，
+    // 把fd和它在channel表中的gen给event.data.u64，便于调用epoll_wait的时候能够从events_中得知是哪个channel发生的事件，
     // 具体见EPollPoller::fillActiveChannels函数
-    event.data.ptr = channel;   
+    event.data.u64 = (static_cast<uint64_t>(channels_[fd].gen) << 32) | static_cast<uint32_t>(fd);
 
+    ++syscalls_;
     if (::epoll_ctl(epollfd_, operation, fd, &event) < 0)
     {
         if (operation == EPOLL_CTL_DEL)
@@ -1,39 +1,49 @@
 #pragma once
 
-#include "noncopyable.h"
-#include "Timestamp.h"
+#include "Poller.h"
 
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <vector>
-#include <unordered_map>
 
-class Channel;
-class EventLoop;
-
-class EPollPoller : noncopyable
+class EPollPoller : public Poller
 {
 public:
-    using ChannelList = std::vector<Channel*>;
     EPollPoller(EventLoop *Loop);
-    ~EPollPoller();
+    ~EPollPoller() override;
 
 
     // 内部就是调用epoll_wait，将有事件发生的channel通过activeChannels返回
-    Timestamp poll(int timeoutMs, ChannelList *activeChannels);
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
 
     // 更新channel上感兴趣的事件
-    void updateChannel(Channel *channel);
+    void updateChannel(Channel *channel) override;
 
     // 当连接销毁时，从EPoller移除channel
-    void removeChannel(Channel *channel);
+    void removeChannel(Channel *channel) override;
+
+    bool hasChannel(Channel *channel) const override;
 
-    // 判断channel是否已经注册到EPoller
-    bool hasChannel(Channel *channel) const;
+    const char* name() const override { return "epoll"; }
+    bool supportsEdgeTriggered() const override { return true; }
 
 private:  
-    using ChannelMap = std::unordered_map<int, Channel*>;
     using EventList = std::vector<epoll_event>;
+
+    /**
+     * channel表，下标就是fd：fd是从小到大复用的整数，直接用数组比哈希表少一次哈希，注册、注销连接也不会申请节点内存
+     * (数组只在出现更大的fd时扩容)。
+     * 每次有新的channel占用这个fd时gen加一，注册到epoll的data.u64是gen<<32|fd，
+     * epoll返回的事件的gen和表中的不一致时说明是已经注销的旧channel的事件(例如fd被dup过，
+     * close以后epoll中的注册还在，fd又被新连接复用)，直接丢弃，不会访问已经释放的Channel
+     */
+    struct ChannelSlot
+    {
+        Channel *channel;
+        uint32_t gen;
+    };
+    // fd对应的表项，必要时扩容
+    ChannelSlot& slot(int fd);
     // 把有事件发生的channel添加到activeChannels中
     void fillActiveChannels(int numEvents, ChannelList *activeChannels) const;
     // 更新channel通道，本质是调用了epoll_ctl
@@ -41,12 +51,11 @@ private:
     
     // 默认监听事件数量
     static const int kInitEventListSize = 16; 
-    // 储存channel 的映射，（sockfd -> channel*）,即，通过fd快速找到对应的channel
-    ChannelMap channels_;
-    // 定义EPoller所属的事件循环EventLoop
-    EventLoop *ownerLoop_; 
+    // channel表的初始大小
+    static const int kInitChannelTableSize = 1024;
     // 每个EPollPoller都有一个epollfd_，epollfd_是epoll_create在内核创建空间返回的fd
     int epollfd_;       
     // 用于存放epoll_wait返回的所有发生的事件
     EventList events_;  
+    std::vector<ChannelSlot> channels_;
 };
\ No newline at end of file
@@ -1,10 +1,13 @@
 
 #include "EventLoop.h"
 #include "Channel.h"
-#include "EPollPoller.h"
+#include "Poller.h"
 #include "TimerQueue.h"
+#include "TcpConnection.h"
 
 #include <sys/eventfd.h>
+#include <time.h>
+#include <algorithm>
 
 
 
@@ -17,6 +20,94 @@ __thread EventLoop *t_loopInThisThread = nullptr;
 // 定义默认的EPoller IO复用接口的超时时间
 const int kPollTimeMs = 10000;
 
+// busy-poll自旋时长的下限，缩小到它以下就是0(不自旋)
+const int kMinSpinUs = 5;
+
+static int64_t monotonicMicros()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * FunctorNode的回收，投递任务的线程和执行任务的loop线程通常不是同一个，节点要跨线程回到生产者手中：
+ *   loop线程执行完任务后把节点压入本loop的freeNodes_(无锁栈，只有loop线程压入，没有ABA问题)；
+ *   queueInLoop先从本线程的缓存中取，缓存为空时用一次exchange把目标loop的freeNodes_整串取走放进缓存，
+ *   都没有时才new。
+ * 生产者投递的速度不超过loop执行的速度时，节点在生产者和loop之间循环使用，稳定以后queueInLoop不再申请内存，
+ * loop线程自己投递的任务(例如writeCompleteCallback、连接的建立和销毁)也是一样
+ */
+struct EventLoop::NodeCache
+{
+    ~NodeCache()
+    {
+        while (head != nullptr)
+        {
+            FunctorNode *node = head;
+            head = static_cast<FunctorNode*>(node->next.load(std::memory_order_relaxed));
+            delete node;
+        }
+    }
+
+    FunctorNode *head = nullptr;
+};
+
+// 每个loop的freeNodes_最多保存的节点数，生产者突发投递时多出来的节点直接释放
+static const int kMaxFreeNodes = 1024;
+
+EventLoop::NodeCache& EventLoop::nodeCache()
+{
+    static thread_local NodeCache cache;
+    return cache;
+}
+
+EventLoop::FunctorNode* EventLoop::allocNode(Functor &&cb)
+{
+    NodeCache &cache = nodeCache();
+    if (cache.head == nullptr && freeNodes_.load(std::memory_order_relaxed) != nullptr)
+    {
+        // 整串取走，和loop线程的压入之间只有这一次exchange
+        FunctorNode *list = freeNodes_.exchange(nullptr, std::memory_order_acquire);
+        int count = 0;
+        for (FunctorNode *node = list; node != nullptr; node = static_cast<FunctorNode*>(node->next.load(std::memory_order_relaxed)))
+        {
+            ++count;
+        }
+        freeNodeCount_.fetch_sub(count, std::memory_order_relaxed);
+        cache.head = list;
+    }
+    FunctorNode *node = cache.head;
+    if (node != nullptr)
+    {
+        cache.head = static_cast<FunctorNode*>(node->next.load(std::memory_order_relaxed));
+    }
+    else
+    {
+        node = new FunctorNode;
+    }
+    node->functor = std::move(cb);
+    return node;
+}
+
+// 只在loop线程中调用
+void EventLoop::freeNode(FunctorNode *node)
+{
+    // 先释放任务捕获的资源(例如TcpConnectionPtr)，不能等到节点被复用时
+    node->functor.reset();
+    if (freeNodeCount_.load(std::memory_order_relaxed) >= kMaxFreeNodes)
+    {
+        delete node;
+        return;
+    }
+    FunctorNode *head = freeNodes_.load(std::memory_order_relaxed);
+    do
+    {
+        node->next.store(head, std::memory_order_relaxed);
+    } while (!freeNodes_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    freeNodeCount_.fetch_add(1, std::memory_order_relaxed);
+}
+
 int createEventfd()
 {
     int evfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
@@ -25,15 +116,24 @@ int createEventfd()
     return evfd;
 }
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(Poller::Type type)
     : looping_(false)
     , quit_(false)
-    , callingPendingFunctors_(false)
+    , sleeping_(false)
     , threadId_(CurrentThread::tid())
-    , epoller_(new EPollPoller(this))
+    , poller_(Poller::newPoller(this, type))
     , timerQueue_(new TimerQueue(this))
     , wakeupFd_(createEventfd())
     , wakeupChannel_(new Channel(this, wakeupFd_))
+    , readScratch_(new char[kReadScratchSize])
+    , pendingCount_(0)
+    , freeNodes_(nullptr)
+    , freeNodeCount_(0)
+    , busyPollMaxUs_(0)
+    , spinBudgetUs_(0)
+    , lastActiveUs_(0)
+    , iterationStartUs_(0)
+    , watchedSinceUs_(0)
 {
     LOG_DEBUG << "EventLoop created " << this << ", the threadId is " << threadId_;
     if (t_loopInThisThread)
@@ -53,10 +153,22 @@ EventLoop::~EventLoop()
 {
     // channel移除所有感兴趣事件
     wakeupChannel_->disableAll();
-    // 将channel从EPollPoller中删除，同时让epollfd不在关注wakeupFd_上发生的任何事件
+    // 将channel从Poller中删除，同时让epollfd不在关注wakeupFd_上发生的任何事件
     wakeupChannel_->remove();
     // 关闭 wakeupFd_
     ::close(wakeupFd_);
+    // 释放没有来得及执行的回调
+    while (MpscNode *node = pendingFunctors_.pop())
+    {
+        freeNode(static_cast<FunctorNode*>(node));
+    }
+    FunctorNode *node = freeNodes_.exchange(nullptr);
+    while (node != nullptr)
+    {
+        FunctorNode *next = static_cast<FunctorNode*>(node->next.load(std::memory_order_relaxed));
+        delete node;
+        node = next;
+    }
     // 指向EventLoop指针为空
     t_loopInThisThread = nullptr;
 }
@@ -69,21 +181,69 @@ void EventLoop::loop()
 
     while (!quit_)
     {
+        // 先标记进入poll，再改动activeChannels_：看门狗的信号处理函数只在iterationStartUs不为0时读取它
+        iterationStartUs_.store(0, std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
         activeChannels_.clear();
+        const bool collectStats = stats_.enabled();
+        int timeoutMs = kPollTimeMs;
+        int64_t pollStartUs = 0;
+        if (busyPollMaxUs_ > 0)
+        {
+            pollStartUs = monotonicMicros();
+            // 还在自旋窗口内：不睡眠，也就不需要别的线程唤醒，queueInLoop加入的回调在下一次轮询时就能看到
+            if (pollStartUs - lastActiveUs_ < spinBudgetUs_)
+            {
+                timeoutMs = 0;
+            }
+        }
+        if (timeoutMs != 0)
+        {
+            // 先声明要睡眠，再检查队列：queueInLoop先增加pendingCount_再检查sleeping_，
+            // 两边都是seq_cst，因此要么这里看到新加入的回调(不阻塞)，要么生产者看到sleeping_并唤醒
+            sleeping_.store(true);
+            if (pendingCount_.load() > 0)
+            {
+                sleeping_.store(false, std::memory_order_relaxed);
+                timeoutMs = 0;
+            }
+        }
+        int64_t pollStartNs = collectStats ? EventLoopStats::nowNanos() : 0;
         // 有事件发生的channel都添加到activeChannels_中，poll函数内部其实就是epoll_wait
-        epollReturnTime_ = epoller_->poll(kPollTimeMs, &activeChannels_);
+        epollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        sleeping_.store(false, std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        iterationStartUs_.store(epollReturnTime_.microSecondsSinceEpoch(), std::memory_order_relaxed);
+        int64_t pollEndNs = collectStats ? EventLoopStats::nowNanos() : 0;
+        if (busyPollMaxUs_ > 0 && (!activeChannels_.empty() || pendingCount_.load(std::memory_order_relaxed) > 0))
+        {
+            int64_t nowUs = monotonicMicros();
+            if (timeoutMs != 0)
+            {
+                adaptSpinBudget(nowUs - pollStartUs);
+            }
+            lastActiveUs_ = nowUs;
+        }
         for (Channel *channel : activeChannels_)
         {
-            channel->handleEvent(epollReturnTime_);
+            // 被监视时本轮中已经移除的channel会被置空
+            if (channel != nullptr)
+            {
+                channel->handleEvent(epollReturnTime_);
+            }
         }
         /**
          * 执行当前EventLoop事件循环需要处理的回调操作 对于线程数 >=2 的情况 IO线程 mainloop(mainReactor) 主要工作：
          * accept接收连接 => 将accept返回的connfd打包为Channel => TcpServer::newConnection通过轮询将TcpConnection对象分配给subloop处理
-         * mainloop调用queueInLoop将回调加入subloop的pendingFunctors_中（该回调需要subloop执行 但subloop还在epoller_->poll处阻塞）
+         * mainloop调用queueInLoop将回调加入subloop的pendingFunctors_中（该回调需要subloop执行 但subloop还在poller_->poll处阻塞）
          * queueInLoop通过wakeup将subloop唤醒，此时subloop就可以执行pendingFunctors_中的保存的函数了
          **/
         // 执行其他线程添加到pendingFunctors_中的函数
         doPendingFunctors();
+        if (collectStats)
+        {
+            stats_.recordIteration(pollEndNs - pollStartNs, EventLoopStats::nowNanos() - pollEndNs, activeChannels_.size());
+        }
     }
     looping_ = false;
 }
@@ -92,7 +252,7 @@ void EventLoop::quit()
 {
     quit_ = true;
     // 从loop()函数中可见，要退出loop()函数中的死循环，就必须再次执行到while处，
-    // 但是如果当前loop没有任何事件发生，此时会阻塞在epoller_->poll()函数这里，
+    // 但是如果当前loop没有任何事件发生，此时会阻塞在poller_->poll()函数这里，
     // 也就是说loop函数无法再次执行到while处，因此，需要向wakeupFd_写入数据，这样
     // 就可以解除阻塞，达到退出的目的
     if (!isInLoopThread()) wakeup();
@@ -108,24 +268,23 @@ void EventLoop::runInLoop(Functor cb)
     }
     else
     {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
 // 把cb放入队列中 唤醒loop所在的线程执行cb
 void EventLoop::queueInLoop(Functor cb)
 {
-    {   
-        std::unique_lock<std::mutex> lock(mutex_);
-        pendingFunctors_.emplace_back(cb);
-    }
-    // callingPendingFunctors_ 比较有必要，因为正在执行回调函数（假设是cb）的过程中，
-    // cb可能会向pendingFunctors_中添加新的回调,
-    // 则这个时候也需要唤醒，否则就会发生有事件到来但是仍被阻塞住的情况。
-    // callingPendingFunctors_在doPendingFunctors函数中被置为true
-    if (!isInLoopThread() || callingPendingFunctors_)  
+    FunctorNode *node = allocNode(std::move(cb));
+    node->enqueueNs = stats_.enabled() ? EventLoopStats::nowNanos() : 0;
+    pendingFunctors_.push(node);
+    pendingCount_.fetch_add(1);
+    // 只有loop阻塞在(或者即将进入)epoll_wait时才需要唤醒。loop正在处理事件或者执行回调时，
+    // 下一轮循环开始前会看到pendingCount_不为0，不会阻塞，因此不必写wakeupFd_。
+    // 多个生产者同时看到sleeping_时只有exchange成功的那一个去唤醒
+    if (sleeping_.load() && sleeping_.exchange(false))
     {
-        wakeup();   
+        wakeup();
     }
 }
 
@@ -152,19 +311,48 @@ void EventLoop::handleRead()
     }
 }
 
+void EventLoop::setBusyPoll(int maxSpinUs)
+{
+    busyPollMaxUs_ = maxSpinUs > 0 ? maxSpinUs : 0;
+    spinBudgetUs_ = busyPollMaxUs_;
+}
+
+void EventLoop::adaptSpinBudget(int64_t blockedUs)
+{
+    if (blockedUs <= busyPollMaxUs_)
+    {
+        // 自旋时长足够的话这次就不用睡眠了
+        spinBudgetUs_ = std::min(std::max(spinBudgetUs_ * 2, kMinSpinUs), busyPollMaxUs_);
+    }
+    else
+    {
+        // 空闲了很久，自旋只是在浪费CPU
+        spinBudgetUs_ /= 2;
+        if (spinBudgetUs_ < kMinSpinUs)
+        {
+            spinBudgetUs_ = 0;
+        }
+    }
+}
+
 void EventLoop::updateChannel(Channel *channel)
 {
-    epoller_->updateChannel(channel);
+    poller_->updateChannel(channel);
 }
 
 void EventLoop::removeChannel(Channel *channel)
 {
-    epoller_->removeChannel(channel);
+    poller_->removeChannel(channel);
+    // channel可能在本轮之后就被销毁，看门狗的信号处理函数不能再通过activeChannels_访问它
+    if (watchedSinceUs_.load(std::memory_order_relaxed) != 0)
+    {
+        std::replace(activeChannels_.begin(), activeChannels_.end(), channel, static_cast<Channel*>(nullptr));
+    }
 }
 
 bool EventLoop::hasChannel(Channel *channel)
 {
-    return epoller_->hasChannel(channel);    
+    return poller_->hasChannel(channel);    
 }
 
 void EventLoop::runAt(Timestamp time, Functor&& cb) {
@@ -183,16 +371,57 @@ void EventLoop::runEvery(double interval, Functor&& cb) {
 
 void EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
-    callingPendingFunctors_ = true;
+    // 只执行本轮开始时已经在队列中的回调，执行过程中新加入的(包括functor自己调用queueInLoop加入的)留到下一轮，
+    // 避免生产者源源不断时loop一直出不去；这些回调使pendingCount_不为0，下一轮的epoll_wait不会阻塞
+    size_t count = pendingCount_.load(std::memory_order_acquire);
+    size_t done = 0;
+    const bool collectStats = stats_.enabled();
+    if (collectStats && count > 0)
+    {
+        stats_.queueDepth().record(count);
+    }
+    while (done < count)
+    {
+        MpscNode *node = pendingFunctors_.pop();
+        if (node == nullptr)
+        {
+            // 生产者还没有完成push，下一轮再取
+            break;
+        }
+        FunctorNode *functorNode = static_cast<FunctorNode*>(node);
+        ++done;
+        if (collectStats && functorNode->enqueueNs != 0)
+        {
+            stats_.queueDelay().record(static_cast<uint64_t>(EventLoopStats::nowNanos() - functorNode->enqueueNs));
+        }
+        functorNode->functor();
+        freeNode(functorNode);
+    }
+    if (done > 0)
+    {
+        pendingCount_.fetch_sub(done, std::memory_order_relaxed);
+    }
+    // 本轮的事件回调和跨线程任务都执行完了，把各个连接积攒的数据各用一次writev发出去。
+    // flush中queueInLoop的回调(例如writeCompleteCallback)会使pendingCount_不为0，下一轮循环不会阻塞
+    flushDirtyConnections();
+}
+
+void EventLoop::flushDirtyConnections()
+{
+    if (dirtyConnections_.empty())
+    {
+        return;
+    }
+    std::vector<TcpConnectionPtr> dirty;
+    dirty.swap(dirtyConnections_);
+    for (const TcpConnectionPtr &conn : dirty)
     {
-        // 通过局部变量functors取出pendingFunctors_中的数据，这样可以提前释放锁。
-        std::unique_lock<std::mutex> lock(mutex_);
-        functors.swap(pendingFunctors_);  // 交换的方式减少了锁的临界区范围 提升效率 同时避免了死锁 如果执行functor()在临界区内 且functor()中调用queueInLoop()就会产生死锁
+        conn->flushCorked();
     }
-    for (const Functor &functor : functors)
+    // 保留vector的容量，下一轮不用重新分配
+    if (dirtyConnections_.empty())
     {
-        functor();
+        dirty.clear();
+        dirty.swap(dirtyConnections_);
     }
-    callingPendingFunctors_ = false;  
 }
\ No newline at end of file
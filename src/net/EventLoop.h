@@ -3,25 +3,30 @@
 #include "noncopyable.h"
 #include "Timestamp.h"
 #include "CurrentThread.h"
+#include "Callback.h"
+#include "MpscQueue.h"
+#include "InlineFunction.h"
+#include "Poller.h"
+#include "EventLoopStats.h"
 
 #include <vector>
 #include <atomic>
 #include <memory>
-#include <mutex>
 #include <functional>
 
 
 
 class Channel;
-class EPollPoller;
 class TimerQueue;
 
 class EventLoop : noncopyable
 {
 public:
-    using Functor = std::function<void()>;
+    // 只能移动的函数对象，捕获的内容不超过64字节时不申请堆内存
+    using Functor = InlineFunction<void()>;
 
-    EventLoop();
+    // type选择IO复用的实现(见Poller)，io_uring不可用时自动退回epoll
+    explicit EventLoop(Poller::Type type = Poller::kEpoll);
     ~EventLoop();
 
     void loop();
@@ -31,12 +36,15 @@ public:
 
     // 让回调函数cb在EventLoop绑定的线程中执行
     void runInLoop(Functor cb);
-    // 让回调函数cb添加到EventLoop的pendingFunctors_中，以便以后在在EventLoop绑定的线程中执行
+    // 让回调函数cb添加到EventLoop的pendingFunctors_中，以便以后在在EventLoop绑定的线程中执行。
+    // 任意线程都可以调用，不加锁；只有loop阻塞在epoll_wait中时才会写wakeupFd_唤醒它
     void queueInLoop(Functor cb);
 
     // 唤醒EPoller，以免唤醒EPoller阻塞在poll函数上（poll函数内部其实就是阻塞在了epoll_wait函数上了），
     // 唤醒的方式：向wakeupFd_写入数据，这样，epoll_wait就会发生可读事件，也就不会继续阻塞了
     void wakeup();
+    // 还没有执行的跨线程回调的个数
+    size_t queueSize() const { return pendingCount_.load(std::memory_order_relaxed); }
 
     // 在EPoller中更新channel感兴趣的事件
     void updateChannel(Channel *channel);
@@ -45,9 +53,56 @@ public:
     // 判断参数channel是否在当前EPoller中
     bool hasChannel(Channel *channel);
 
+    // 实际使用的IO复用实现("epoll"/"io_uring")，以及它发起的系统调用次数
+    const char* pollerName() const { return poller_->name(); }
+    uint64_t pollerSyscalls() const { return poller_->syscalls(); }
+    bool supportsEdgeTriggered() const { return poller_->supportsEdgeTriggered(); }
+
     // 判断EventLoop初始化时绑定的线程id是否和当前正在运行的线程id是否一致
     bool isInLoopThread() const { return threadId_ == CurrentThread::tid(); }
 
+    // 本loop所有连接共用的接收溢出区，Buffer::readFd在inputBuffer_写不下时先把数据暂存在这里。
+    // 同一个loop中的连接是串行读取的，因此一个loop只需要一块，不必每次读都在栈上准备64KB
+    static const size_t kReadScratchSize = 64 * 1024;
+    char* readScratch() { return readScratch_.get(); }
+
+    // auto-cork：连接在本轮循环中积攒了待发送的数据，doPendingFunctors结束时统一调用TcpConnection::flushCorked发送
+    void addDirtyConnection(const TcpConnectionPtr &conn) { dirtyConnections_.push_back(conn); }
+
+    /**
+     * busy-poll：有事件发生以后的一段时间内用超时为0的epoll_wait轮询，不进入睡眠，
+     * 省掉睡眠/唤醒的延迟(对延迟敏感的服务这部分往往决定了p99)，代价是这段时间一直占用CPU。
+     * 自旋时长在(0, maxSpinUs]之间自适应：阻塞以后很快就来了事件说明多转一会儿就能接住，加倍；
+     * 阻塞了很久说明负载低，减半。maxSpinUs为0时关闭(默认)，需要在loop线程中或者loop()之前调用
+     */
+    void setBusyPoll(int maxSpinUs);
+    int busyPollMax() const { return busyPollMaxUs_; }
+    // 当前的自旋时长(微秒)
+    int spinBudget() const { return spinBudgetUs_; }
+
+    // 运行统计(见EventLoopStats)，默认关闭。任意线程都可以开关和读取，开关在下一轮循环生效
+    void setStatsEnabled(bool on) { stats_.setEnabled(on); }
+    EventLoopStats& stats() { return stats_; }
+    const EventLoopStats& stats() const { return stats_; }
+
+    /**
+     * 看门狗(见LoopWatchdog)读取的状态：
+     * iterationStartUs   本轮循环poll返回的时刻(微秒)，为0表示loop在poll中(或者还没有开始循环)。
+     *                    只有loop线程写：每轮进入poll之前写0，poll返回以后写开始时刻，回调中没有任何store
+     * watchedSinceUs     开始被监视的时刻，0表示没有被监视。被监视时removeChannel会把本轮activeChannels_中
+     *                    对应的指针置空，看门狗的信号处理函数读取activeChannels_时就不会碰到已经销毁的channel
+     * numActiveChannels/activeChannel   本轮有事件的channel，只能在loop线程中调用(看门狗的信号处理函数)，
+     *                    可能为nullptr(本轮中已经被移除)
+     */
+    int64_t iterationStartUs() const { return iterationStartUs_.load(std::memory_order_relaxed); }
+    bool isInPoll() const { return iterationStartUs() == 0; }
+    bool isLooping() const { return looping_.load(std::memory_order_relaxed); }
+    pid_t threadId() const { return threadId_; }
+    int64_t watchedSinceUs() const { return watchedSinceUs_.load(std::memory_order_relaxed); }
+    void setWatchedSince(int64_t us) { watchedSinceUs_.store(us); }
+    size_t numActiveChannels() const { return activeChannels_.size(); }
+    Channel* activeChannel(size_t i) const { return activeChannels_[i]; }
+
     // 定时器相关函数
     // 在time时刻执行回调函数cb
     void runAt(Timestamp time, Functor&& cb); 
@@ -59,23 +114,48 @@ public:
 private:
     using ChannelList = std::vector<Channel*>;
 
+    // pendingFunctors_中的节点
+    struct FunctorNode : MpscNode
+    {
+        Functor functor;
+        int64_t enqueueNs;      // 加入队列的时刻，只在开启统计时记录，否则为0
+    };
+    // 节点的回收：loop线程把执行完的节点还给本loop的freeNodes_，投递任务的线程整串取走放进自己的缓存，见EventLoop.cc
+    struct NodeCache;
+    static NodeCache& nodeCache();
+    FunctorNode* allocNode(Functor &&cb);
+    void freeNode(FunctorNode *node);
+
     // wakeupChannel_可读事件的回调函数
     void handleRead();
     void doPendingFunctors();
+    void flushDirtyConnections();
+    // 一次阻塞的poll返回了事件，根据阻塞的时长调整自旋时长
+    void adaptSpinBudget(int64_t blockedUs);
 
     std::atomic_bool looping_;                  // 是否正在事件循环中
     std::atomic_bool quit_;                     // 是否退出事件循环
-    std::atomic_bool callingPendingFunctors_;   // 是否正在调用待执行的函数
+    std::atomic_bool sleeping_;                 // loop是否(即将)阻塞在epoll_wait中，只有这时才需要写wakeupFd_
     const pid_t threadId_;                      // 当前loop所属线程的id
     Timestamp epollReturnTime_;                 // EPoller管理的fd有事件发生时的时间（也就是epoll_wait返回的时间）
-    std::unique_ptr<EPollPoller> epoller_;      // 
+    std::unique_ptr<Poller> poller_;            // IO复用(epoll或者io_uring)
     std::unique_ptr<TimerQueue> timerQueue_;    // 管理当前loop所有定时器的容器
 
     // wakeupFd_用于唤醒EPoller，以免EPoller阻塞了无法执行pendingFunctors_中的待处理的函数
     int wakeupFd_;                              
     std::unique_ptr<Channel>wakeupChannel_;     // wakeupFd_对应的Channel
     ChannelList activeChannels_;                // 有事件发生的Channel集合
-    std::mutex mutex_;                          // 用于保护pendingFunctors_线程安全操作(添加或取出)
-    std::vector<Functor> pendingFunctors_;      // 存储loop跨线程需要执行的所有回调操作
+    std::unique_ptr<char[]> readScratch_;       // 接收溢出区（只申请一次，不需要初始化）
+    MpscQueue pendingFunctors_;                 // 存储loop跨线程需要执行的所有回调操作(无锁，多个线程添加，loop线程取出)
+    std::atomic<size_t> pendingCount_;          // pendingFunctors_中的回调个数，loop据此决定epoll_wait是否阻塞
+    std::atomic<FunctorNode*> freeNodes_;       // 执行完的节点(只有loop线程压入，投递任务的线程整串取走)
+    std::atomic<int> freeNodeCount_;            // freeNodes_中大约的节点数，超过上限时直接delete
+    int busyPollMaxUs_;                         // 自旋时长的上限，0表示不自旋
+    int spinBudgetUs_;                          // 当前的自旋时长
+    int64_t lastActiveUs_;                      // 最近一次有事件的时刻(单调时钟，微秒)
+    std::vector<TcpConnectionPtr> dirtyConnections_;    // 开启了auto-cork并且本轮有数据待发送的连接（只在loop线程中访问）
+    EventLoopStats stats_;                      // 运行统计
+    std::atomic<int64_t> iterationStartUs_;     // 本轮循环poll返回的时刻，在poll中时为0，给看门狗读取
+    std::atomic<int64_t> watchedSinceUs_;       // 开始被看门狗监视的时刻，0表示没有被监视
     
 };
\ No newline at end of file
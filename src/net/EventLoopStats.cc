@@ -0,0 +1,103 @@
+#include "EventLoopStats.h"
+
+#include <stdio.h>
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0)
+    , sum_(0)
+    , max_(0)
+{
+    for (auto &bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum()) / static_cast<double>(n);
+}
+
+uint64_t LatencyHistogram::percentile(double p) const
+{
+    uint64_t counts[kNumBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        counts[i] = bucketCount(i);
+        total += counts[i];
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+    // 第rank个(从1开始)记录所在的桶
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    if (rank < 1) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i)
+    {
+        seen += counts[i];
+        if (seen >= rank)
+        {
+            // 不超过真实的最大值
+            uint64_t upper = bucketUpperBound(i);
+            uint64_t maxValue = max();
+            return upper < maxValue ? upper : maxValue;
+        }
+    }
+    return max();
+}
+
+EventLoopStats::EventLoopStats()
+    : enabled_(false)
+{
+}
+
+void EventLoopStats::recordIteration(int64_t waitNs, int64_t workNs, size_t events)
+{
+    pollWait_.record(static_cast<uint64_t>(waitNs));
+    loopWork_.record(static_cast<uint64_t>(workNs));
+    events_.record(events);
+}
+
+double EventLoopStats::utilization() const
+{
+    double wait = static_cast<double>(pollWait_.sum());
+    double work = static_cast<double>(loopWork_.sum());
+    return wait + work > 0 ? work / (wait + work) : 0.0;
+}
+
+static void appendLine(std::string &out, const char *name, const LatencyHistogram &h)
+{
+    char line[160];
+    ::snprintf(line, sizeof(line), "%-14s count %-10llu mean %-10.0f p50 %-10llu p99 %-10llu max %llu\n",
+               name,
+               static_cast<unsigned long long>(h.count()),
+               h.mean(),
+               static_cast<unsigned long long>(h.percentile(0.5)),
+               static_cast<unsigned long long>(h.percentile(0.99)),
+               static_cast<unsigned long long>(h.max()));
+    out += line;
+}
+
+std::string EventLoopStats::toString() const
+{
+    std::string out;
+    char line[64];
+    ::snprintf(line, sizeof(line), "utilization    %.1f%%\n", utilization() * 100);
+    out += line;
+    appendLine(out, "pollWait(ns)", pollWait_);
+    appendLine(out, "loopWork(ns)", loopWork_);
+    appendLine(out, "events", events_);
+    appendLine(out, "read(ns)", callbacks_[kReadCallback]);
+    appendLine(out, "write(ns)", callbacks_[kWriteCallback]);
+    appendLine(out, "close(ns)", callbacks_[kCloseCallback]);
+    appendLine(out, "error(ns)", callbacks_[kErrorCallback]);
+    appendLine(out, "queueDepth", queueDepth_);
+    appendLine(out, "queueDelay(ns)", queueDelay_);
+    appendLine(out, "timerLate(ns)", timerLateness_);
+    return out;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * 按2的幂分桶的直方图：第0个桶是0，第i个桶是[2^(i-1), 2^i)，65个桶覆盖全部uint64_t。
+ * 只有一个线程(所属loop的线程)写入，任意线程都可以读取：写入方用relaxed的load+store累加，
+ * 不需要带lock前缀的原子指令。
+ * 读取方看到的各项之间可能差一两次记录(例如count和桶的总和)，用来看分布足够了
+ */
+class LatencyHistogram : noncopyable
+{
+public:
+    static const int kNumBuckets = 65;
+
+    LatencyHistogram();
+
+    // 只能在写入线程中调用
+    void record(uint64_t value)
+    {
+        bump(buckets_[bucketOf(value)], 1);
+        bump(count_, 1);
+        bump(sum_, value);
+        if (value > max_.load(std::memory_order_relaxed))
+        {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    double mean() const;
+    // 第p(0~1)分位所在桶的上界，近似值，误差不超过一倍
+    uint64_t percentile(double p) const;
+    uint64_t bucketCount(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+    static int bucketOf(uint64_t value)
+    {
+        return value == 0 ? 0 : 64 - __builtin_clzll(value);
+    }
+    // 第i个桶的上界(包含)
+    static uint64_t bucketUpperBound(int i)
+    {
+        return i == 0 ? 0 : (i >= 64 ? UINT64_MAX : (uint64_t(1) << i) - 1);
+    }
+
+private:
+    static void bump(std::atomic<uint64_t> &counter, uint64_t delta)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets_[kNumBuckets];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+/**
+ * 一个EventLoop的运行统计(EventLoop::setStatsEnabled开启)，时间单位都是纳秒：
+ *   pollWait        每次poll(epoll_wait/io_uring_enter)花的时间，包括阻塞等待
+ *   loopWork        每轮循环poll返回以后处理事件、执行回调花的时间
+ *   events          每轮循环poll返回的事件个数
+ *   callback(type)  Channel::handleEvent中每种回调(读、写、关闭、错误)执行一次花的时间
+ *   queueDepth      每轮开始执行跨线程回调时队列中的回调个数(只记录非空的时候)
+ *   queueDelay      跨线程回调从queueInLoop到开始执行的时间
+ *   timerLateness   定时器实际执行的时刻比预定时刻晚了多少(定时器精度是微秒)
+ * 只在loop线程中写入，任意线程都可以读取，开启以后每轮循环和每个回调多两次clock_gettime(vDSO，不陷入内核)
+ */
+class EventLoopStats : noncopyable
+{
+public:
+    enum CallbackType
+    {
+        kReadCallback,
+        kWriteCallback,
+        kCloseCallback,
+        kErrorCallback,
+        kNumCallbackTypes,
+    };
+
+    EventLoopStats();
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void setEnabled(bool on) { enabled_.store(on, std::memory_order_relaxed); }
+
+    static int64_t nowNanos()
+    {
+        struct timespec ts;
+        ::clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    // 记录一轮循环
+    void recordIteration(int64_t waitNs, int64_t workNs, size_t events);
+
+    uint64_t iterations() const { return pollWait_.count(); }
+    // loop线程忙碌的时间占比：处理事件的时间 / (等待 + 处理)
+    double utilization() const;
+
+    LatencyHistogram& pollWait() { return pollWait_; }
+    LatencyHistogram& loopWork() { return loopWork_; }
+    LatencyHistogram& events() { return events_; }
+    LatencyHistogram& callback(CallbackType type) { return callbacks_[type]; }
+    LatencyHistogram& queueDepth() { return queueDepth_; }
+    LatencyHistogram& queueDelay() { return queueDelay_; }
+    LatencyHistogram& timerLateness() { return timerLateness_; }
+
+    const LatencyHistogram& pollWait() const { return pollWait_; }
+    const LatencyHistogram& loopWork() const { return loopWork_; }
+    const LatencyHistogram& events() const { return events_; }
+    const LatencyHistogram& callback(CallbackType type) const { return callbacks_[type]; }
+    const LatencyHistogram& queueDepth() const { return queueDepth_; }
+    const LatencyHistogram& queueDelay() const { return queueDelay_; }
+    const LatencyHistogram& timerLateness() const { return timerLateness_; }
+
+    // 一行一项的摘要(次数、平均值、p50/p99/最大值)，用于日志
+    std::string toString() const;
+
+private:
+    std::atomic_bool enabled_;
+    LatencyHistogram pollWait_;
+    LatencyHistogram loopWork_;
+    LatencyHistogram events_;
+    LatencyHistogram callbacks_[kNumCallbackTypes];
+    LatencyHistogram queueDepth_;
+    LatencyHistogram queueDelay_;
+    LatencyHistogram timerLateness_;
+};
+
+/**
+ * 记录一段代码的执行时间，histogram为空时什么也不做：
+ *     ScopedLatency timing(stats.enabled() ? &stats.loopWork() : nullptr);
+ */
+class ScopedLatency : noncopyable
+{
+public:
+    explicit ScopedLatency(LatencyHistogram *histogram)
+        : histogram_(histogram)
+        , start_(histogram != nullptr ? EventLoopStats::nowNanos() : 0)
+    {
+    }
+
+    ~ScopedLatency()
+    {
+        if (histogram_ != nullptr)
+        {
+            histogram_->record(static_cast<uint64_t>(EventLoopStats::nowNanos() - start_));
+        }
+    }
+
+private:
+    LatencyHistogram *histogram_;
+    int64_t start_;
+};
@@ -3,13 +3,15 @@
 #include "EventLoop.h"
 
 EventLoopThread::EventLoopThread(const ThreadInitCallback &cb,
-                                 const std::string &name)
+                                 const std::string &name,
+                                 Poller::Type pollerType)
     : loop_(nullptr)
     , exiting_(false)
     , thread_(std::bind(&EventLoopThread::threadFunc, this), name) // 新线程绑定此函数
     , mutex_()
     , cond_()
     , callback_(cb) // 传入的线程初始化回调函数，用户自定义的
+    , pollerType_(pollerType)
 {
 }
 
@@ -43,9 +45,20 @@ EventLoop* EventLoopThread::startLoop()
     return loop;
 }
 
+bool EventLoopThread::runInLoopIfRunning(std::function<void()> cb)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (loop_ == nullptr)
+    {
+        return false;
+    }
+    loop_->runInLoop(std::move(cb));
+    return true;
+}
+
 void EventLoopThread::threadFunc()
 {
-    EventLoop loop;
+    EventLoop loop(pollerType_);
 
     // 用户自定义的线程初始化完成后要执行的函数
     if (callback_)
@@ -2,6 +2,7 @@
 
 #include "noncopyable.h"
 #include "Thread.h"
+#include "Poller.h"
 
 #include <mutex>
 #include <condition_variable>
@@ -18,12 +19,20 @@ public:
     using ThreadInitCallback = std::function<void(EventLoop*)>;
 
     EventLoopThread(const ThreadInitCallback &cb = ThreadInitCallback(),
-                    const std::string& name = std::string());
+                    const std::string& name = std::string(),
+                    Poller::Type pollerType = Poller::kEpoll);
     ~EventLoopThread();
 
+    // 线程的放置策略，在startLoop之前设置(见Thread::setPlacement)
+    void setPlacement(const ThreadPlacement &placement, int index) { thread_.setPlacement(placement, index); }
+
     // 开启一个新线程
     EventLoop *startLoop(); 
 
+    // loop还在运行时调用loop->runInLoop(cb)并返回true；loop已经退出(EventLoop已经销毁)时返回false。
+    // 持有mutex_投递，loop线程要先拿到mutex_才能把loop_置空，投递以后loop才退出时cb会随EventLoop析构而被释放、不会执行
+    bool runInLoopIfRunning(std::function<void()> cb);
+
 private:
     // 线程执行函数
     void threadFunc();
@@ -34,6 +43,7 @@ private:
     std::mutex mutex_;              // 互斥锁,这里是配合条件变量使用
     std::condition_variable cond_;  // 条件变量, 主线程等待子线程创建EventLoop对象完成
     ThreadInitCallback callback_;   // 线程初始化完成后要执行的函数
+    Poller::Type pollerType_;       // 子线程的EventLoop使用的IO复用实现
 
 };
 
@@ -8,6 +8,7 @@ EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const std::string
     , started_(false)
     , numThreads_(0)
     , next_(0)
+    , pollerType_(Poller::kEpoll)
 {
 }
 
@@ -25,7 +26,8 @@ void EventLoopThreadPool::start(const ThreadInitCallback &cb)
     {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread *t = new EventLoopThread(cb, buf);
+        EventLoopThread *t = new EventLoopThread(cb, buf, pollerType_);
+        t->setPlacement(placement_, i);
         // 加入此EventLoopThread入容器
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         // 底层创建线程 绑定一个新的EventLoop 并返回该loop的地址
@@ -74,4 +76,15 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
     {
         return loops_;
     }
-}
\ No newline at end of file
+}
+bool EventLoopThreadPool::runInLoopIfRunning(EventLoop *loop, std::function<void()> cb)
+{
+    for (size_t i = 0; i < loops_.size(); ++i)
+    {
+        if (loops_[i] == loop)
+        {
+            return threads_[i]->runInLoopIfRunning(std::move(cb));
+        }
+    }
+    return false;
+}
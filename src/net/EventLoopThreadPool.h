@@ -5,6 +5,9 @@
 #include <memory>
 #include <vector>
 
+#include "Poller.h"
+#include "ThreadPlacement.h"
+
 class EventLoop;
 class EventLoopThread;
 
@@ -15,7 +18,14 @@ public:
     EventLoopThreadPool(EventLoop *baseLoop, const std::string &nameArg);
     ~EventLoopThreadPool();
 
-    void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    // placement决定subLoop线程放在哪些CPU上、用什么调度策略(见ThreadPlacement)，第i个subLoop放到第i个槽上
+    void setThreadNum(int numThreads, const ThreadPlacement &placement = ThreadPlacement())
+    {
+        numThreads_ = numThreads;
+        placement_ = placement;
+    }
+    // subLoop使用的IO复用实现，在start之前设置(baseLoop由用户创建，不受影响)
+    void setPollerType(Poller::Type type) { pollerType_ = type; }
 
     // 启动线程池
     void start(const ThreadInitCallback &cb = ThreadInitCallback());
@@ -25,6 +35,9 @@ public:
 
     std::vector<EventLoop*> getAllLoops();
 
+    // loop是线程池中的subLoop并且还在运行时投递cb并返回true，见EventLoopThread::runInLoopIfRunning
+    bool runInLoopIfRunning(EventLoop *loop, std::function<void()> cb);
+
     bool started() const { return started_; }
 
     const std::string name() const { return name_; }
@@ -36,6 +49,8 @@ private:
     bool started_;              // 是否已经开启线程池
     int numThreads_;
     size_t next_;               // 轮训的下标
+    Poller::Type pollerType_;
+    ThreadPlacement placement_;
     std::vector<std::unique_ptr<EventLoopThread>> threads_;
     std::vector<EventLoop*> loops_;
 };
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include "IoUringPoller.h"
+#include "Channel.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <algorithm>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Channel在Poller中的状态，与EPollPoller相同
+const int kNew = -1;
+const int kAdded = 1;
+
+static int ioUringSetup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop)
+    , ringFd_(-1)
+    , sqEntries_(0)
+    , sqRing_(nullptr)
+    , sqRingSize_(0)
+    , sqHead_(nullptr)
+    , sqTail_(nullptr)
+    , sqMask_(nullptr)
+    , sqArray_(nullptr)
+    , sqes_(nullptr)
+    , sqesSize_(0)
+    , sqeTail_(0)
+    , cqRing_(nullptr)
+    , cqRingSize_(0)
+    , cqHead_(nullptr)
+    , cqTail_(nullptr)
+    , cqMask_(nullptr)
+    , cqes_(nullptr)
+    , nextGen_(1)
+{
+    if (!setupRing())
+    {
+        unmapRing();
+        if (ringFd_ >= 0)
+        {
+            ::close(ringFd_);
+            ringFd_ = -1;
+        }
+    }
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    if (ringFd_ >= 0)
+    {
+        unmapRing();
+        ::close(ringFd_);
+    }
+}
+
+bool IoUringPoller::setupRing()
+{
+    struct io_uring_params params;
+    ::memset(&params, 0, sizeof(params));
+    // COOP_TASKRUN：完成事件等到下一次io_uring_enter时再处理，不用IPI打断正在运行的loop线程；
+    // SUBMIT_ALL：某个SQE出错时继续提交后面的SQE
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SUBMIT_ALL;
+    ringFd_ = ioUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0 && errno == EINVAL)
+    {
+        // 老内核不认识这些标志
+        ::memset(&params, 0, sizeof(params));
+        ringFd_ = ioUringSetup(kRingEntries, &params);
+    }
+    if (ringFd_ < 0)
+    {
+        LOG_WARN << "io_uring_setup failed, errno=" << errno;
+        return false;
+    }
+    // 需要EXT_ARG才能在io_uring_enter中直接带超时时间；NODROP保证完成队列满了也不丢事件
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        LOG_WARN << "io_uring lacks EXT_ARG/NODROP, features=" << params.features;
+        return false;
+    }
+
+    sqEntries_ = params.sq_entries;
+    sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap)
+    {
+        sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+    }
+
+    sqRing_ = ::mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (sqRing_ == MAP_FAILED)
+    {
+        sqRing_ = nullptr;
+        LOG_WARN << "io_uring mmap sq ring failed, errno=" << errno;
+        return false;
+    }
+    if (singleMmap)
+    {
+        cqRing_ = sqRing_;
+    }
+    else
+    {
+        cqRing_ = ::mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED)
+        {
+            cqRing_ = nullptr;
+            LOG_WARN << "io_uring mmap cq ring failed, errno=" << errno;
+            return false;
+        }
+    }
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        LOG_WARN << "io_uring mmap sqes failed, errno=" << errno;
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char *sq = static_cast<char*>(sqRing_);
+    sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sqeTail_ = *sqTail_;
+
+    char *cq = static_cast<char*>(cqRing_);
+    cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    LOG_DEBUG << "create a new io_uring, fd = " << ringFd_ << " sq entries = " << sqEntries_;
+    return true;
+}
+
+void IoUringPoller::unmapRing()
+{
+    if (sqes_ != nullptr)
+    {
+        ::munmap(sqes_, sqesSize_);
+        sqes_ = nullptr;
+    }
+    if (cqRing_ != nullptr && cqRing_ != sqRing_)
+    {
+        ::munmap(cqRing_, cqRingSize_);
+    }
+    cqRing_ = nullptr;
+    if (sqRing_ != nullptr)
+    {
+        ::munmap(sqRing_, sqRingSize_);
+        sqRing_ = nullptr;
+    }
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+        // 提交队列满了，先把已经填好的提交掉
+        enter(0, 0);
+    }
+    unsigned index = sqeTail_ & *sqMask_;
+    struct io_uring_sqe *sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof(*sqe));
+    sqArray_[index] = index;
+    ++sqeTail_;
+    return sqe;
+}
+
+int IoUringPoller::enter(unsigned waitNr, int timeoutMs)
+{
+    // 发布本地填好的SQE，内核看到新的tail才会处理
+    __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    if (waitNr > 0 && timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    // 即使不等待也带上GETEVENTS：COOP_TASKRUN模式下，内核在这里才把就绪的poll请求写进完成队列
+    int ret = ioUringEnter(ringFd_, toSubmit, waitNr, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    ++syscalls_;
+    return ret < 0 ? -errno : ret;
+}
+
+void IoUringPoller::armPoll(int fd, uint32_t events, PollState *state)
+{
+    state->gen = nextGen_++;
+    if (nextGen_ == 0)
+    {
+        nextGen_ = 1;
+    }
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = makeUserData(fd, state->gen);
+    state->events = events;
+    state->armed = true;
+}
+
+void IoUringPoller::cancelPoll(int fd, PollState *state)
+{
+    // 旧请求被取消时产生的完成事件(-ECANCELED)编号对不上，会被忽略。取消请求本身的完成事件user_data为0
+    struct io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(fd, state->gen);
+    sqe->user_data = 0;
+    state->armed = false;
+}
+
+void IoUringPoller::markDirty(int fd, PollState *state)
+{
+    if (!state->dirty)
+    {
+        state->dirty = true;
+        rearm_.push_back(fd);
+    }
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    if (channel->index() != kAdded)
+    {
+        channels_[fd] = channel;
+        channel->set_index(kAdded);
+        states_[fd] = PollState{0, 0, false, false};
+    }
+    PollState &state = states_[fd];
+    if (state.armed && state.events == static_cast<uint32_t>(channel->events()))
+    {
+        return;
+    }
+    // 事件变了就取消旧请求，统一在下一次poll之前按照新的事件挂上；同一轮中多次修改只会提交一次
+    if (state.armed)
+    {
+        cancelPoll(fd, &state);
+    }
+    markDirty(fd, &state);
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    channels_.erase(fd);
+    auto it = states_.find(fd);
+    if (it != states_.end())
+    {
+        if (it->second.armed)
+        {
+            cancelPoll(fd, &it->second);
+        }
+        states_.erase(it);
+    }
+    channel->set_index(kNew);
+}
+
+bool IoUringPoller::hasChannel(Channel *channel) const
+{
+    auto it = channels_.find(channel->fd());
+    return it != channels_.end() && it->second == channel;
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    // 上一轮完成的、修改过事件的channel按照当前感兴趣的事件重新挂上poll请求
+    for (int fd : rearm_)
+    {
+        auto it = states_.find(fd);
+        if (it == states_.end())
+        {
+            continue;
+        }
+        PollState &state = it->second;
+        state.dirty = false;
+        Channel *channel = channels_[fd];
+        if (!state.armed && !channel->isNoneEvent())
+        {
+            armPoll(fd, channel->events(), &state);
+        }
+    }
+    rearm_.clear();
+
+    // 完成队列中还有没取走的事件时不等待
+    bool haveCompletions = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    int ret = enter(haveCompletions || timeoutMs == 0 ? 0 : 1, timeoutMs);
+    int saveErrno = ret < 0 ? -ret : 0;
+    Timestamp now(Timestamp::now());
+    // ETIME：等待超时；EINTR：被信号打断；EBUSY：完成队列溢出，先取走完成事件
+    if (ret < 0 && saveErrno != ETIME && saveErrno != EINTR && saveErrno != EBUSY)
+    {
+        errno = saveErrno;
+        LOG_ERROR << "IoUringPoller::poll() failed, errno=" << saveErrno;
+    }
+    reapCompletions(activeChannels);
+    return now;
+}
+
+void IoUringPoller::reapCompletions(ChannelList *activeChannels)
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe &cqe = cqes_[head & *cqMask_];
+        if (cqe.user_data == 0)
+        {
+            continue;
+        }
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t gen = static_cast<uint32_t>(cqe.user_data >> 32);
+        auto it = states_.find(fd);
+        if (it == states_.end() || !it->second.armed || it->second.gen != gen)
+        {
+            // 已经取消或者fd已经被其他channel复用
+            continue;
+        }
+        PollState &state = it->second;
+        state.armed = false;
+        markDirty(fd, &state);
+        if (cqe.res == -ECANCELED)
+        {
+            continue;
+        }
+        // poll请求的结果就是poll(2)的事件掩码，和EPOLLIN/EPOLLOUT等取值相同
+        Channel *channel = channels_[fd];
+        channel->set_revents(cqe.res < 0 ? static_cast<int>(EPOLLERR) : cqe.res);
+        activeChannels->push_back(channel);
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
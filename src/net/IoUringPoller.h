@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Poller.h"
+
+#include <stddef.h>
+#include <linux/io_uring.h>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * 用io_uring实现的Poller，直接使用io_uring_setup/io_uring_enter系统调用，不依赖liburing。
+ *
+ * 每个Channel在内核中挂一个IORING_OP_POLL_ADD请求，事件发生后请求完成，下一次poll之前按照Channel当时
+ * 感兴趣的事件重新挂上。修改、注销事件也只是往提交队列里填一个SQE，所有这些请求和等待完成事件
+ * 合并成一次io_uring_enter，不像epoll那样每次修改都要单独调用一次epoll_ctl。
+ *
+ * 没有使用multishot poll：multishot只在fd的等待队列被唤醒时产生完成事件，相当于边沿触发，
+ * 而Channel/TcpConnection按照水平触发编写(一次只读一部分数据、暂停/恢复读取等)。一次性的poll请求
+ * 在挂上时会检查fd当前的状态，重新挂上就得到水平触发的语义，代价只是每个事件多填一个SQE，不多一次系统调用
+ *
+ * 内核不支持io_uring或者缺少需要的特性(IORING_FEAT_EXT_ARG，5.11)时valid()返回false，由Poller::newPoller退回epoll
+ */
+class IoUringPoller : public Poller
+{
+public:
+    explicit IoUringPoller(EventLoop *loop);
+    ~IoUringPoller() override;
+
+    bool valid() const { return ringFd_ >= 0; }
+
+    Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+    void updateChannel(Channel *channel) override;
+    void removeChannel(Channel *channel) override;
+    bool hasChannel(Channel *channel) const override;
+
+    const char* name() const override { return "io_uring"; }
+
+private:
+    // 提交队列的大小，完成队列是它的两倍
+    static const unsigned kRingEntries = 1024;
+
+    // 一个fd在内核中挂着的poll请求
+    struct PollState
+    {
+        uint32_t gen;           // 请求的编号，和fd一起组成user_data，用来识别已经被取消的旧请求的完成事件
+        uint32_t events;        // 请求关注的事件
+        bool armed;             // 内核中有还没有完成的poll请求
+        bool dirty;             // 已经加入rearm_，下一次poll之前检查是否需要重新挂上
+    };
+
+    bool setupRing();
+    void unmapRing();
+    // 取一个空闲的SQE，提交队列满了就先提交一次
+    struct io_uring_sqe* getSqe();
+    // 把填好的SQE提交给内核，waitNr大于0时最多等待timeoutMs毫秒
+    int enter(unsigned waitNr, int timeoutMs);
+    void armPoll(int fd, uint32_t events, PollState *state);
+    void cancelPoll(int fd, PollState *state);
+    void markDirty(int fd, PollState *state);
+    void reapCompletions(ChannelList *activeChannels);
+
+    static uint64_t makeUserData(int fd, uint32_t gen)
+    {
+        return (static_cast<uint64_t>(gen) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    int ringFd_;
+    unsigned sqEntries_;
+
+    // 提交队列(与内核共享的内存)
+    void *sqRing_;
+    size_t sqRingSize_;
+    unsigned *sqHead_;
+    unsigned *sqTail_;
+    unsigned *sqMask_;
+    unsigned *sqArray_;
+    struct io_uring_sqe *sqes_;
+    size_t sqesSize_;
+    unsigned sqeTail_;          // 本地填写到的位置，提交时才写回*sqTail_
+
+    // 完成队列(与内核共享的内存，支持IORING_FEAT_SINGLE_MMAP时和提交队列是同一块映射)
+    void *cqRing_;
+    size_t cqRingSize_;
+    unsigned *cqHead_;
+    unsigned *cqTail_;
+    unsigned *cqMask_;
+    struct io_uring_cqe *cqes_;
+
+    uint32_t nextGen_;
+    std::unordered_map<int, Channel*> channels_;
+    std::unordered_map<int, PollState> states_;
+    std::vector<int> rearm_;    // 需要在下一次poll之前检查、重新挂上poll请求的fd
+};
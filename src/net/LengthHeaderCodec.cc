@@ -0,0 +1,46 @@
+#include "LengthHeaderCodec.h"
+#include "Buffer.h"
+#include "TcpConnection.h"
+#include "Logging.h"
+
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime)
+{
+    // 一次可读事件可能带来多帧数据，也可能不足一帧
+    while (buf->readableBytes() >= kHeaderLen)
+    {
+        const int32_t len = buf->peekInt32();
+        if (len < 0 || static_cast<size_t>(len) > maxFrameLength_)
+        {
+            LOG_ERROR << "LengthHeaderCodec invalid length " << len << " from " << conn->name();
+            // 后面的数据已经无法分帧，丢弃缓冲区并直接断开，不能只关闭写端继续接收
+            buf->retrieveAll();
+            conn->forceClose();
+            break;
+        }
+        if (buf->readableBytes() < kHeaderLen + len)
+        {
+            break;      // 消息体还没有收全
+        }
+        frameCallback_(conn, buf->peek() + kHeaderLen, len, receiveTime);
+        buf->retrieve(kHeaderLen + len);
+    }
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, const char *data, size_t len)
+{
+    Buffer buf(len);
+    buf.append(data, len);
+    send(conn, &buf);
+}
+
+void LengthHeaderCodec::send(const TcpConnectionPtr &conn, Buffer *payload)
+{
+    const size_t len = payload->readableBytes();
+    if (len > maxFrameLength_)
+    {
+        LOG_ERROR << "LengthHeaderCodec::send frame too large: " << len;
+        return;
+    }
+    payload->prependInt32(static_cast<int32_t>(len));
+    conn->send(payload);
+}
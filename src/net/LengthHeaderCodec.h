@@ -0,0 +1,51 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "Timestamp.h"
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * 基于长度头部的消息分帧：每条消息前面是4字节网络字节序的消息体长度
+ * +----------+-----------------------+
+ * | len(4B)  |   body (len bytes)    |
+ * +----------+-----------------------+
+ *
+ * 使用方法：把onMessage注册为TcpServer的MessageCallback，收到完整的一帧时调用用户的FrameCallback，
+ * 传给用户的data直接指向inputBuffer_中的消息体（不拷贝），只在回调期间有效，回调返回后这一帧就会被retrieve掉。
+ *
+ *     LengthHeaderCodec codec(std::bind(&Server::onFrame, this, _1, _2, _3, _4));
+ *     server.setMessageCallback(std::bind(&LengthHeaderCodec::onMessage, &codec, _1, _2, _3));
+ *
+ * 发送时把长度写进Buffer的kCheapPrepend空间，不需要为了加头部再拷贝一次消息体
+ */
+class LengthHeaderCodec : noncopyable
+{
+public:
+    using FrameCallback = std::function<void(const TcpConnectionPtr&, const char* data, size_t len, Timestamp)>;
+
+    static const size_t kHeaderLen = sizeof(int32_t);
+    static const size_t kDefaultMaxFrameLength = 64 * 1024 * 1024;    // 64M
+
+    explicit LengthHeaderCodec(const FrameCallback &cb, size_t maxFrameLength = kDefaultMaxFrameLength)
+        : frameCallback_(cb)
+        , maxFrameLength_(maxFrameLength)
+    {
+    }
+
+    // 从buf中切出所有完整的帧交给FrameCallback，不完整的帧留在buf中等待后续数据
+    void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp receiveTime);
+
+    // 发送一帧，body会被拷贝进一个新的Buffer，然后在其prepend区写入长度
+    void send(const TcpConnectionPtr &conn, const char *data, size_t len);
+    void send(const TcpConnectionPtr &conn, const std::string &body) { send(conn, body.data(), body.size()); }
+    // 发送一帧，body就是payload中的全部可读数据，长度直接写进payload的prepend区，payload发送后被清空
+    void send(const TcpConnectionPtr &conn, Buffer *payload);
+
+private:
+    FrameCallback frameCallback_;
+    const size_t maxFrameLength_;       // 超过这个长度的帧被视为非法数据，连接会被关闭
+};
@@ -0,0 +1,336 @@
+#include "LoopWatchdog.h"
+#include "EventLoop.h"
+#include "Channel.h"
+#include "Logging.h"
+#include "Timestamp.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+
+const int kMaxFrames = 64;
+const size_t kMaxNameLen = 128;
+const size_t kMaxChannels = LoopWatchdog::kMaxReportedChannels;
+// 等待卡住的线程执行信号处理函数的最长时间
+const int kSignalWaitMs = 100;
+
+struct ChannelSnapshot
+{
+    int fd;
+    int revents;
+    char name[kMaxNameLen];
+    size_t nameLen;
+};
+
+/**
+ * 看门狗线程和信号处理函数之间传递数据，同一时刻只有一个请求(g_requestMutex)。
+ * 看门狗线程写好请求以后store(loop, release)再发信号，处理函数只在目标loop的线程中、
+ * 并且这一轮循环还没有结束时才读取activeChannels_，写完结果以后store(done, release)
+ */
+struct StallRequest
+{
+    std::atomic<EventLoop*> loop{nullptr};
+    int64_t startUs = 0;
+    bool captureStack = false;
+
+    bool sameIteration = false;
+    size_t numActive = 0;
+    ChannelSnapshot channels[kMaxChannels];
+    size_t numChannels = 0;
+    void *frames[kMaxFrames];
+    int depth = 0;
+    std::atomic_bool done{false};
+};
+
+StallRequest g_request;
+std::mutex g_requestMutex;
+
+// 在卡住的线程中执行，只能调用异步信号安全的函数
+void stallSignalHandler(int)
+{
+    int savedErrno = errno;
+    EventLoop *loop = g_request.loop.load(std::memory_order_acquire);
+    if (loop == nullptr || static_cast<pid_t>(::syscall(SYS_gettid)) != loop->threadId())
+    {
+        errno = savedErrno;
+        return;
+    }
+    // 还在看门狗发现的那一轮循环中(不在poll中)，activeChannels_不会被修改。
+    // 开始被监视之前就已经开始的那一轮，移除的channel没有被置空，不能读取
+    int64_t startUs = loop->iterationStartUs();
+    int64_t watchedSinceUs = loop->watchedSinceUs();
+    g_request.sameIteration = startUs != 0 && startUs == g_request.startUs;
+    if (g_request.sameIteration && watchedSinceUs != 0 && startUs > watchedSinceUs)
+    {
+        g_request.numActive = loop->numActiveChannels();
+        for (size_t i = 0; i < g_request.numActive && g_request.numChannels < kMaxChannels; ++i)
+        {
+            Channel *channel = loop->activeChannel(i);
+            if (channel == nullptr)
+            {
+                continue;
+            }
+            ChannelSnapshot &snapshot = g_request.channels[g_request.numChannels++];
+            snapshot.fd = channel->fd();
+            snapshot.revents = channel->revents();
+            snapshot.nameLen = 0;
+            const std::string *name = channel->name();
+            if (name != nullptr)
+            {
+                snapshot.nameLen = name->size() < kMaxNameLen ? name->size() : kMaxNameLen;
+                ::memcpy(snapshot.name, name->data(), snapshot.nameLen);
+            }
+        }
+    }
+    if (g_request.captureStack)
+    {
+        g_request.depth = ::backtrace(g_request.frames, kMaxFrames);
+    }
+    g_request.done.store(true, std::memory_order_release);
+    errno = savedErrno;
+}
+
+// 和Channel::handleEventWithGuard的判断一致
+std::string callbacksFor(int revents)
+{
+    std::string out;
+    auto add = [&out](const char *name) {
+        if (!out.empty()) out += '/';
+        out += name;
+    };
+    if ((revents & EPOLLHUP) && !(revents & EPOLLIN)) add("close");
+    if (revents & EPOLLERR) add("error");
+    if (revents & (EPOLLIN | EPOLLPRI | EPOLLRDHUP)) add("read");
+    if (revents & EPOLLOUT) add("write");
+    return out;
+}
+
+} // namespace
+
+LoopWatchdog::LoopWatchdog(double thresholdSeconds, const std::string &name)
+    : threshold_(thresholdSeconds)
+    , thresholdUs_(static_cast<int64_t>(thresholdSeconds * Timestamp::kMicroSecondsPerSecond))
+    , captureStack_(false)
+    , signo_(SIGRTMIN + 1)
+    , thread_(std::bind(&LoopWatchdog::threadFunc, this), name)
+    , running_(false)
+{
+}
+
+LoopWatchdog::~LoopWatchdog()
+{
+    stop();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Entry &entry : entries_)
+    {
+        entry.loop->setWatchedSince(0);
+    }
+}
+
+void LoopWatchdog::watch(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(Entry{loop, 0});
+    loop->setWatchedSince(Timestamp::now().microSecondsSinceEpoch());
+}
+
+void LoopWatchdog::unwatch(EventLoop *loop)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it)
+    {
+        if (it->loop == loop)
+        {
+            loop->setWatchedSince(0);
+            entries_.erase(it);
+            return;
+        }
+    }
+}
+
+void LoopWatchdog::start()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+    // 第一次调用backtrace时glibc会加载libgcc(申请内存)，先在这里调用一次，信号处理函数中就是安全的了
+    void *frames[1];
+    ::backtrace(frames, 1);
+    struct sigaction action;
+    ::memset(&action, 0, sizeof(action));
+    action.sa_handler = stallSignalHandler;
+    action.sa_flags = SA_RESTART;
+    ::sigemptyset(&action.sa_mask);
+    if (::sigaction(signo_, &action, nullptr) < 0)
+    {
+        LOG_ERROR << "LoopWatchdog::start sigaction failed, errno=" << errno;
+    }
+    thread_.start();
+}
+
+void LoopWatchdog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+        {
+            return;
+        }
+        running_ = false;
+    }
+    cond_.notify_all();
+    thread_.join();
+}
+
+void LoopWatchdog::threadFunc()
+{
+    const auto period = std::chrono::microseconds(thresholdUs_ / 4 > 1000 ? thresholdUs_ / 4 : 1000);
+    std::vector<StallInfo> stalls;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_)
+    {
+        cond_.wait_for(lock, period);
+        if (!running_)
+        {
+            break;
+        }
+        // 持有mutex_检查和收集，unwatch返回以后就不会再访问那个loop
+        int64_t nowUs = Timestamp::now().microSecondsSinceEpoch();
+        for (Entry &entry : entries_)
+        {
+            StallInfo info;
+            if (check(entry, nowUs, &info))
+            {
+                stalls.push_back(std::move(info));
+            }
+        }
+        if (stalls.empty())
+        {
+            continue;
+        }
+        // 打印和用户回调不持有mutex_，回调中可以watch/unwatch
+        lock.unlock();
+        for (const StallInfo &info : stalls)
+        {
+            report(info);
+        }
+        stalls.clear();
+        lock.lock();
+    }
+}
+
+bool LoopWatchdog::check(Entry &entry, int64_t nowUs, StallInfo *info)
+{
+    EventLoop *loop = entry.loop;
+    // 为0表示阻塞在poll中，不算卡住
+    int64_t startUs = loop->iterationStartUs();
+    if (!loop->isLooping() || startUs == 0 || startUs == entry.reportedStartUs || nowUs - startUs < thresholdUs_)
+    {
+        return false;
+    }
+    entry.reportedStartUs = startUs;
+    collect(loop, startUs, nowUs, info);
+    return true;
+}
+
+void LoopWatchdog::collect(EventLoop *loop, int64_t startUs, int64_t nowUs, StallInfo *info)
+{
+    info->loop = loop;
+    info->tid = loop->threadId();
+    info->seconds = static_cast<double>(nowUs - startUs) / Timestamp::kMicroSecondsPerSecond;
+    info->numActiveChannels = 0;
+
+    std::lock_guard<std::mutex> lock(g_requestMutex);
+    g_request.startUs = startUs;
+    g_request.captureStack = captureStack_;
+    g_request.sameIteration = false;
+    g_request.numActive = 0;
+    g_request.numChannels = 0;
+    g_request.depth = 0;
+    g_request.done.store(false, std::memory_order_relaxed);
+    g_request.loop.store(loop, std::memory_order_release);
+    bool answered = false;
+    if (::syscall(SYS_tgkill, ::getpid(), info->tid, signo_) == 0)
+    {
+        for (int waitedUs = 0; waitedUs < kSignalWaitMs * 1000; waitedUs += 100)
+        {
+            if (g_request.done.load(std::memory_order_acquire))
+            {
+                answered = true;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+    else
+    {
+        LOG_ERROR << "LoopWatchdog::collect tgkill failed, errno=" << errno;
+    }
+    g_request.loop.store(nullptr, std::memory_order_release);
+    if (!answered)
+    {
+        return;
+    }
+
+    if (g_request.sameIteration)
+    {
+        info->numActiveChannels = g_request.numActive;
+        for (size_t i = 0; i < g_request.numChannels; ++i)
+        {
+            const ChannelSnapshot &snapshot = g_request.channels[i];
+            info->activeChannels.push_back(ChannelInfo{snapshot.fd,
+                                                       std::string(snapshot.name, snapshot.nameLen),
+                                                       callbacksFor(snapshot.revents)});
+        }
+    }
+    if (g_request.depth > 0)
+    {
+        char **symbols = ::backtrace_symbols(g_request.frames, g_request.depth);
+        if (symbols != nullptr)
+        {
+            for (int i = 0; i < g_request.depth; ++i)
+            {
+                info->stack.push_back(symbols[i]);
+            }
+            ::free(symbols);
+        }
+    }
+}
+
+void LoopWatchdog::report(const StallInfo &info)
+{
+    std::string channels;
+    for (const ChannelInfo &channel : info.activeChannels)
+    {
+        if (!channels.empty()) channels += ", ";
+        channels += (channel.name.empty() ? std::string("-") : channel.name)
+                  + "(fd " + std::to_string(channel.fd) + " " + channel.callbacks + ")";
+    }
+    if (info.numActiveChannels > info.activeChannels.size())
+    {
+        channels += ", ...";
+    }
+    LOG_WARN << "LoopWatchdog: EventLoop " << info.loop << " (tid " << info.tid << ") has been in one iteration for "
+             << info.seconds * 1000 << "ms (threshold " << threshold_ * 1000 << "ms), active channels ("
+             << info.numActiveChannels << "): " << (channels.empty() ? std::string("-") : channels);
+    for (const std::string &frame : info.stack)
+    {
+        LOG_WARN << "    " << frame;
+    }
+    if (stallCallback_)
+    {
+        stallCallback_(info);
+    }
+}
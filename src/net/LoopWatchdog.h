@@ -0,0 +1,93 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+class EventLoop;
+
+/**
+ * EventLoop看门狗：一个独立的线程每隔threshold/4检查一次被监视的loop，
+ * 一轮循环(poll返回以后处理事件和回调)超过threshold还没有结束时报告一次：
+ * 卡住的loop和线程、时长、本轮有事件的channel(名字、fd和按事件会执行的回调)，
+ * setCaptureStack(true)时还有卡住的线程的调用栈，从中可以看出具体卡在哪个回调里。
+ *
+ * loop的热路径上只多了iterationStartUs一个变量(见EventLoop::iterationStartUs)：每轮进入poll之前写0、
+ * poll返回以后写开始时刻，只有loop线程写它，看门狗据此区分"阻塞在poll中"和"卡在回调中"；回调中没有任何store。
+ * channel的信息由看门狗向卡住的线程发送信号，在信号处理函数中从loop的activeChannels_读取：
+ * 被监视的loop在removeChannel时把本轮activeChannels_中的指针置空，读到的channel一定还活着，
+ * 处理函数只做memcpy和backtrace，不申请内存。
+ *
+ * 看门狗要先于它监视的loop销毁，或者在loop销毁之前unwatch
+ */
+class LoopWatchdog : noncopyable
+{
+public:
+    struct ChannelInfo
+    {
+        int fd;
+        std::string name;               // channel的名字(TcpConnection是连接名)，没有时为空
+        std::string callbacks;          // 按本轮的事件会执行的回调，例如"read"、"read/write"、"close"
+    };
+    struct StallInfo
+    {
+        EventLoop *loop;
+        pid_t tid;                      // 卡住的loop线程
+        double seconds;                 // 报告时本轮循环已经执行的时间
+        // 本轮有事件的channel(最多kMaxReportedChannels个，已经移除的不算)：卡住的是其中某个channel的回调，
+        // 或者是它们之后的跨线程回调(doPendingFunctors)。线程没有回应信号时为空
+        std::vector<ChannelInfo> activeChannels;
+        size_t numActiveChannels;       // 本轮有事件的channel总数
+        std::vector<std::string> stack; // 调用栈，没有开启setCaptureStack时为空
+    };
+    static const size_t kMaxReportedChannels = 8;
+    using StallCallback = std::function<void(const StallInfo&)>;
+
+    explicit LoopWatchdog(double thresholdSeconds, const std::string &name = std::string("LoopWatchdog"));
+    ~LoopWatchdog();
+
+    // 任意线程都可以调用，start之前或者之后都可以
+    void watch(EventLoop *loop);
+    void unwatch(EventLoop *loop);
+
+    // 报告时抓取卡住线程的调用栈(需要-rdynamic才能看到可执行文件中的函数名)，在start之前设置
+    void setCaptureStack(bool on) { captureStack_ = on; }
+    // 发给卡住线程的信号，默认SIGRTMIN+1，在start之前设置
+    void setSignal(int signo) { signo_ = signo; }
+    // 报告时除了LOG_WARN以外还调用cb(在看门狗线程中)，在start之前设置
+    void setStallCallback(const StallCallback &cb) { stallCallback_ = cb; }
+
+    void start();
+    void stop();
+
+private:
+    struct Entry
+    {
+        EventLoop *loop;
+        int64_t reportedStartUs;    // 已经报告过的那一轮的开始时刻，同一轮只报告一次
+    };
+
+    void threadFunc();
+    // 持有mutex_调用，卡住时向loop线程发信号收集信息，填好info返回true
+    bool check(Entry &entry, int64_t nowUs, StallInfo *info);
+    void collect(EventLoop *loop, int64_t startUs, int64_t nowUs, StallInfo *info);
+    // 不持有mutex_调用：打印并调用stallCallback_，用户回调中可以watch/unwatch
+    void report(const StallInfo &info);
+
+    const double threshold_;
+    const int64_t thresholdUs_;
+    bool captureStack_;
+    int signo_;
+    StallCallback stallCallback_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    std::vector<Entry> entries_;
+};
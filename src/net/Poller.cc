@@ -0,0 +1,20 @@
+#include "Poller.h"
+#include "Channel.h"
+#include "EPollPoller.h"
+#include "IoUringPoller.h"
+#include "Logging.h"
+
+Poller* Poller::newPoller(EventLoop *loop, Type type)
+{
+    if (type == kIoUring)
+    {
+        IoUringPoller *poller = new IoUringPoller(loop);
+        if (poller->valid())
+        {
+            return poller;
+        }
+        delete poller;
+        LOG_WARN << "io_uring is not available, falls back to epoll";
+    }
+    return new EPollPoller(loop);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <vector>
+
+class Channel;
+class EventLoop;
+
+/**
+ * IO复用的抽象接口，EventLoop只通过它等待事件、注册和注销Channel。
+ * 两种实现：EPollPoller(epoll，默认) 和 IoUringPoller(io_uring的poll请求)，在构造EventLoop时选择
+ */
+class Poller : noncopyable
+{
+public:
+    using ChannelList = std::vector<Channel*>;
+
+    enum Type
+    {
+        kEpoll,
+        kIoUring,
+    };
+
+    explicit Poller(EventLoop *loop) : ownerLoop_(loop), syscalls_(0) {}
+    virtual ~Poller() = default;
+
+    // 等待事件，把有事件发生的channel通过activeChannels返回，返回值为等待结束的时刻
+    virtual Timestamp poll(int timeoutMs, ChannelList *activeChannels) = 0;
+
+    // 更新channel上感兴趣的事件
+    virtual void updateChannel(Channel *channel) = 0;
+
+    // 当连接销毁时，从Poller移除channel
+    virtual void removeChannel(Channel *channel) = 0;
+
+    // 判断channel是否已经注册到Poller
+    virtual bool hasChannel(Channel *channel) const = 0;
+
+    virtual const char* name() const = 0;
+    // 是否支持边沿触发(EPOLLET)的Channel
+    virtual bool supportsEdgeTriggered() const { return false; }
+    // Poller自己发起的系统调用次数(epoll_wait/epoll_ctl或者io_uring_enter)，用于比较不同实现的开销
+    uint64_t syscalls() const { return syscalls_; }
+
+    // 创建type类型的Poller，io_uring不可用(内核版本太低、被seccomp禁止等)时退回到epoll
+    static Poller* newPoller(EventLoop *loop, Type type);
+
+protected:
+    // 定义Poller所属的事件循环EventLoop
+    EventLoop *ownerLoop_;
+    uint64_t syscalls_;
+};
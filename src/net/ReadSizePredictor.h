@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * 根据最近几次读到的字节数预测下一次read的大小，TcpConnection::handleRead会先保证inputBuffer_
+ * 至少有这么大的可写空间，让数据尽量直接读进inputBuffer_，少走EventLoop溢出区再拷贝一次的路径。
+ *
+ * 策略（和Netty的AdaptiveRecvByteBufAllocator类似）：
+ * 1. 一次就把预测的空间读满了，说明对端发得快，下次预测值翻倍
+ * 2. 连续两次读到的数据都不到预测值的一半，下次预测值减半（只看一次容易被偶然的小包误导）
+ * 预测值始终在[kMinReadSize, kMaxReadSize]之间
+ */
+class ReadSizePredictor
+{
+public:
+    static const size_t kMinReadSize = 512;
+    static const size_t kInitialReadSize = 2048;
+    static const size_t kMaxReadSize = 64 * 1024;
+
+    ReadSizePredictor()
+        : nextReadSize_(kInitialReadSize)
+        , decreasePending_(false)
+    {
+    }
+
+    size_t nextReadSize() const { return nextReadSize_; }
+
+    // 记录本次实际读到的字节数
+    void record(size_t n)
+    {
+        if (n >= nextReadSize_)
+        {
+            nextReadSize_ = nextReadSize_ * 2 > kMaxReadSize ? kMaxReadSize : nextReadSize_ * 2;
+            decreasePending_ = false;
+        }
+        else if (n <= nextReadSize_ / 2)
+        {
+            if (decreasePending_)
+            {
+                nextReadSize_ = nextReadSize_ / 2 < kMinReadSize ? kMinReadSize : nextReadSize_ / 2;
+                decreasePending_ = false;
+            }
+            else
+            {
+                decreasePending_ = true;
+            }
+        }
+        else
+        {
+            decreasePending_ = false;
+        }
+    }
+
+private:
+    size_t nextReadSize_;
+    bool decreasePending_;     // 上一次已经读得很少了，再少一次就缩小预测值
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * 一次发送的多段数据(scatter-gather)，例如HTTP响应的头部和消息体，交给TcpConnection::send(const SendList&)
+ * 用一次writev发送，不需要先拼接到同一块内存中。
+ * SendList只记录各段的地址和长度，不持有数据：在loop线程中send时没有发完的部分会被拷贝进发送缓冲区，
+ * 跨线程send时会先整体拷贝一次，所以send返回后数据就可以释放了
+ */
+class SendList
+{
+public:
+    static const int kMaxSegments = 16;
+
+    SendList() : count_(0), totalBytes_(0) {}
+
+    // 已经有kMaxSegments段时不再添加并返回false，调用者应该先send已有的部分、clear以后再继续
+    bool append(const void *data, size_t len)
+    {
+        if (len == 0)
+        {
+            return true;
+        }
+        if (full())
+        {
+            return false;
+        }
+        iov_[count_].iov_base = const_cast<void *>(data);
+        iov_[count_].iov_len = len;
+        ++count_;
+        totalBytes_ += len;
+        return true;
+    }
+    bool append(const std::string &str) { return append(str.data(), str.size()); }
+
+    const struct iovec* iov() const { return iov_; }
+    int count() const { return count_; }
+    bool full() const { return count_ >= kMaxSegments; }
+    size_t totalBytes() const { return totalBytes_; }
+
+    void clear()
+    {
+        count_ = 0;
+        totalBytes_ = 0;
+    }
+
+private:
+    struct iovec iov_[kMaxSegments];
+    int count_;
+    size_t totalBytes_;
+};
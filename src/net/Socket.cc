@@ -22,10 +22,10 @@ void Socket::bindAddress(const InetAddress &localaddr)
     }
 }
 
-void Socket::listen()
+void Socket::listen(int backlog)
 {
-    // 监听队列长度设置为1024，超过1024则不受理客户连接
-    if (0 != ::listen(sockfd_, 1024))
+    // 监听队列满了以后不再受理客户连接
+    if (0 != ::listen(sockfd_, backlog))
     {
         LOG_FATAL << "listen sockfd: " << sockfd_ << " fail";
     }
@@ -42,8 +42,9 @@ int Socket::accept(InetAddress *peeraddr)
     {
         peeraddr->setSockAddr(addr);
     }
-    else
+    else if (errno != EAGAIN && errno != EWOULDBLOCK)
     {
+        // 已经没有待接受的连接是批量accept的正常结束条件，不是错误
         LOG_ERROR << "accept4() failed";
     }
     return connfd;
@@ -91,4 +92,51 @@ void Socket::setKeepAlive(bool on)
 {
     int optval = on ? 1 : 0;
     ::setsockopt(sockfd_, SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval)); // TCP_NODELAY包含头文件 <netinet/tcp.h>
+}
+
+bool Socket::setBusyPoll(int usec)
+{
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof(usec)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_BUSY_POLL failed, fd=" << sockfd_ << " errno=" << errno;
+        return false;
+    }
+    return true;
+}
+
+// TCP_DEFER_ACCEPT：三次握手完成后先不把连接放进accept队列，等客户端发来第一段数据(最多等seconds秒)，
+// 服务器accept时数据已经到了，不会为只连接不发送的客户端唤醒。适合客户端先发送请求的协议(HTTP等)
+bool Socket::setDeferAccept(int seconds)
+{
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &seconds, sizeof(seconds)) < 0)
+    {
+        LOG_ERROR << "setsockopt TCP_DEFER_ACCEPT failed, fd=" << sockfd_ << " errno=" << errno;
+        return false;
+    }
+    return true;
+}
+
+// TCP_FASTOPEN：客户端可以在SYN中携带数据(带上之前拿到的cookie)，重复连接时省掉一个RTT，
+// 还需要net.ipv4.tcp_fastopen的服务器端开关(0x2)
+bool Socket::setFastOpen(int queueLen)
+{
+    if (::setsockopt(sockfd_, IPPROTO_TCP, TCP_FASTOPEN, &queueLen, sizeof(queueLen)) < 0)
+    {
+        LOG_ERROR << "setsockopt TCP_FASTOPEN failed, fd=" << sockfd_ << " errno=" << errno;
+        return false;
+    }
+    return true;
+}
+
+// SO_ZEROCOPY(Linux 4.14+)：打开以后send时带上MSG_ZEROCOPY，内核直接引用用户内存中的页而不是拷贝，
+// 发送完成后通过socket的错误队列通知用户，在此之前这块内存不能修改或释放
+bool Socket::setZeroCopy(bool on)
+{
+    int optval = on ? 1 : 0;
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ZEROCOPY, &optval, sizeof(optval)) < 0)
+    {
+        LOG_ERROR << "setsockopt SO_ZEROCOPY failed, fd=" << sockfd_;
+        return false;
+    }
+    return true;
 }
\ No newline at end of file
@@ -16,9 +16,9 @@ public:
     int fd() const { return sockfd_; }
     // 绑定sockfd
     void bindAddress(const InetAddress &localaddr);
-    // 监听
-    void listen();
-    // 接受连接
+    // 监听，backlog是已完成三次握手、等待accept的连接队列长度(内核会截断到net.core.somaxconn)
+    void listen(int backlog = 1024);
+    // 接受连接，没有待接受的连接时返回-1并且errno为EAGAIN(不打印日志)
     int accept(InetAddress *peeraddr);
 
     // 设置半关闭
@@ -28,6 +28,10 @@ public:
     void setReuseAddr(bool on);     // 设置地址复用
     void setReusePort(bool on);     // 设置端口复用
     void setKeepAlive(bool on);     // 设置长连接
+    bool setZeroCopy(bool on);      // 设置SO_ZEROCOPY，之后才能使用MSG_ZEROCOPY发送，内核不支持时返回false
+    bool setBusyPoll(int usec);     // 设置SO_BUSY_POLL，阻塞读时在网卡队列上忙等usec微秒，超过net.core.busy_read需要CAP_NET_ADMIN
+    bool setDeferAccept(int seconds);   // 设置监听socket的TCP_DEFER_ACCEPT，连接上有数据到达以后才能被accept
+    bool setFastOpen(int queueLen);     // 设置监听socket的TCP_FASTOPEN，queueLen是还没有完成握手的TFO请求的队列长度
 
 private:
     const int sockfd_;
@@ -4,6 +4,7 @@
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "TcpRelay.h"
 
 #include <functional>
 #include <string.h>
@@ -12,6 +13,11 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
 
 
 // 提供一个默认的ConnectionCallback，如果自定义的服务器（比如EchoServer）没有注册
@@ -50,17 +56,34 @@ TcpConnection::TcpConnection(EventLoop *loop,
     , name_(nameArg)
     , state_(kConnecting)
     , reading_(true)
+    , readPauseReasons_(0)
+    , edgeTriggered_(false)
+    , edgeReadBudget_(0)
+    , writePending_(false)
     , socket_(new Socket(sockfd))
     , channel_(new Channel(loop, sockfd))
     , localAddr_(localAddr)
     , peerAddr_(peerAddr)
     , highWaterMark_(64 * 1024 * 1024)  // 64M
+    , lowWaterMark_(0)
+    , aboveHighWaterMark_(false)
+    , inputBufferLimit_(0)
+    , outputHardLimit_(0)
+    , outputGraceSeconds_(0)
+    , aboveHardLimit_(false)
+    , hardLimitSeq_(0)
+    , autoCork_(false)
+    , corked_(false)
+    , zeroCopy_(false)
+    , zeroCopyThreshold_(64 * 1024)
+    , zeroCopyNextId_(0)
 {
     // 绑定channel_各个事件发生时要执行的回调函数
     channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
     channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+    channel_->setCloseCallback(std::bind(&TcpConnection::handleHangup, this));
     channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    channel_->setName(&name_);
 
     LOG_INFO << "TcpConnection::creator[" << name_.c_str() << "] at fd =" << sockfd;
     socket_->setKeepAlive(true);
@@ -89,6 +112,24 @@ void TcpConnection::send(const std::string &buf)
 }
 
 
+void TcpConnection::send(std::string &&message)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendStringInLoop(std::move(message));
+        }
+        else
+        {
+            // string直接移进任务里，跨线程既不拷贝数据也不额外申请内存
+            loop_->runInLoop([conn = shared_from_this(), message = std::move(message)]() mutable {
+                conn->sendStringInLoop(std::move(message));
+            });
+        }
+    }
+}
+
 void TcpConnection::send(Buffer* buf)   
 {
     // 如果连接是已经建立的，就把buffer中的数据取出来发送出去
@@ -96,12 +137,32 @@ void TcpConnection::send(Buffer* buf)
     {
         if (loop_->isInLoopThread())
         {
-            sendInLoop(buf->retrieveAllAsString());
+            // 在loop线程中直接从buf发送，没发完的部分拷贝到outputBuffer_，不需要先转成string
+            sendInLoop(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
         }
         else
         {   
-            std::string msg = buf->retrieveAllAsString();
-            loop_->runInLoop(std::bind((void(TcpConnection::*)(const std::string&))&TcpConnection::sendInLoop, this, msg));
+            // 把buf的存储空间整个换出来交给loop线程，buf换成一个空的Buffer
+            std::shared_ptr<Buffer> moved = std::make_shared<Buffer>(0);
+            moved->swap(*buf);
+            loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, shared_from_this(), moved));
+        }
+    }
+}
+
+void TcpConnection::send(const PayloadPtr &payload)
+{
+    if (state_ == kConnected && payload)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendPayloadInLoop(payload);
+        }
+        else
+        {
+            // 跨线程只需要传递一个shared_ptr，数据本身不拷贝
+            loop_->runInLoop(std::bind(&TcpConnection::sendPayloadInLoop, shared_from_this(), payload));
         }
     }
 }
@@ -111,37 +172,75 @@ void TcpConnection::sendInLoop(const std::string& message)
     sendInLoop(message.data(), message.size());
 }
 
-
-/**
- * 在当前所属loop中发送数据data。发送前，先判断outputBuffer_中是否还有数据需要发送，如果没有，
- * 则直接把要发送的数据data发送出去。如果有，则把data中的数据添加到outputBuffer_中，并注册可
- * 写事件
- **/
-void TcpConnection::sendInLoop(const void *data, size_t len)
+void TcpConnection::sendStringInLoop(std::string &&message)
 {
-    ssize_t nwrote = 0;         // 已经发送的数据长度
-    size_t remaining = len;     // 还剩下多少数据需要发送
-    bool faultError = false;    // 记录是否产生错误
-
-    if (state_ == kDisconnected)//  之前调用过该connection的shutdown 不能再进行发送了）
+    if (zeroCopy_ && message.size() >= zeroCopyThreshold_)
+    {
+        // MSG_ZEROCOPY发送完成之前内核一直引用着这些页，string必须活得比输出缓冲区里的段更久，
+        // 只能交给payload托管(只有这种大消息才多一次控制块的分配)
+        sendPayloadInLoop(makePayload(std::move(message)));
+        return;
+    }
+    if (state_ == kDisconnected)
     {
         LOG_ERROR << "disconnected, give up writing";
         return;
     }
 
+    bool faultError = false;
+    size_t nwrote = writeDirect(message.data(), message.size(), DataHolder(), &faultError);
+    if (!faultError && nwrote < message.size())
+    {
+        checkHighWaterMark(message.size() - nwrote);
+        outputBuffer_.appendString(std::move(message), nwrote);
+        scheduleWrite();
+    }
+}
+
+void TcpConnection::sendPayloadInLoop(const PayloadPtr& payload)
+{
+    sendInLoop(payload->data(), payload->size(), payload);
+}
+
+void TcpConnection::sendBufferInLoop(const std::shared_ptr<Buffer>& buf)
+{
+    sendInLoop(buf->peek(), buf->readableBytes(), buf);
+}
+
+
+size_t TcpConnection::writeDirect(const void *data, size_t len, const DataHolder &owner, bool *faultError)
+{
     // 当channel_没有注册可写事件并且outputBuffer_中也没有数据要发送了，则直接*data中的数据发送出去
     // 疑问：什么时候isWriting返回false?
     // 答：刚初始化的channel和数据发送完毕的channel都是没有可写事件在epoll上的,即isWriting返回false，
     // 对于后者，见本类的handlWrite函数，发现只要把数据发送完毕，他就注销了可写事件
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
+    // (边沿触发时可写事件一直注册着，waitingWritable()看的是writePending_)
+    // 开启auto-cork时不直接发送，先排队，等本轮循环结束时和其他send的数据一起发送
+    ssize_t nwrote = 0;
+    if (!autoCork_ && !waitingWritable() && outputBuffer_.readableBytes() == 0)
     {
-        nwrote = ::write(channel_->fd(), data, len);
+        if (owner && zeroCopy_ && len >= zeroCopyThreshold_)
+        {
+            nwrote = ::send(channel_->fd(), data, len, MSG_ZEROCOPY);
+            if (nwrote > 0)
+            {
+                pinZeroCopy(owner);
+            }
+            else if (nwrote < 0 && errno == ENOBUFS)
+            {
+                // 锁定的页超过了optmem限制，这一次退回普通的拷贝发送
+                nwrote = ::write(channel_->fd(), data, len);
+            }
+        }
+        else
+        {
+            nwrote = ::write(channel_->fd(), data, len);
+        }
         if (nwrote >= 0)
         {
-            remaining = len - nwrote;
-            if (remaining == 0 && writeCompleteCallback_)
+            if (static_cast<size_t>(nwrote) == len && writeCompleteCallback_)
             {
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                queueWriteComplete();
             }
         }
         else
@@ -149,30 +248,419 @@ void TcpConnection::sendInLoop(const void *data, size_t len)
             nwrote = 0;
             if (errno != EWOULDBLOCK)   // EWOULDBLOCK表示非阻塞情况下没有数据后的正常返回 等同于EAGAIN
             {
-                LOG_ERROR << "TcpConnection::sendInLoop";
+                LOG_ERROR << "TcpConnection::writeDirect";
                 if (errno == EPIPE || errno == ECONNRESET) // SIGPIPE RESET
                 {
-                    faultError = true;
+                    *faultError = true;
                 }
             }
         }
     }
+    return static_cast<size_t>(nwrote);
+}
+
+/**
+ * 在当前所属loop中发送数据data。发送前，先判断outputBuffer_中是否还有数据需要发送，如果没有，
+ * 则直接把要发送的数据data发送出去。如果有，则把data中的数据添加到outputBuffer_中，并注册可
+ * 写事件
+ **/
+void TcpConnection::sendInLoop(const void *data, size_t len, const DataHolder &owner)
+{
+    ssize_t nwrote = 0;         // 已经发送的数据长度
+    size_t remaining = len;     // 还剩下多少数据需要发送
+    bool faultError = false;    // 记录是否产生错误
+
+    if (state_ == kDisconnected)//  之前调用过该connection的shutdown 不能再进行发送了）
+    {
+        LOG_ERROR << "disconnected, give up writing";
+        return;
+    }
+
+    nwrote = writeDirect(data, len, owner, &faultError);
+    remaining = len - nwrote;
 
     // 如果数据没有全部发送出去，则把剩余的数据都添加到outputBuffer_中，并向Epoller中注册可写事件
     if (!faultError && remaining > 0)
     {
-        size_t oldLen = outputBuffer_.readableBytes();  // 目前发送缓冲区剩余的待发送的数据的长度
-        // 判断待写数据是否会超过设置的高位标志highWaterMark_
-        if (oldLen +remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_)
+        checkHighWaterMark(remaining);
+        if (owner)
+        {
+            // data就在owner里面，只挂一个引用段
+            outputBuffer_.appendRef(owner, static_cast<const char *>(data) + nwrote, remaining);
+        }
+        else
+        {
+            outputBuffer_.append((char *)data + nwrote, remaining);     // 将data中剩余还没有发送的数据最佳到buffer中
+        }
+        scheduleWrite();
+    }
+}
+
+void TcpConnection::scheduleWrite()
+{
+    if (waitingWritable())
+    {
+        return;
+    }
+    if (autoCork_)
+    {
+        if (!corked_)
+        {
+            corked_ = true;
+            loop_->addDirtyConnection(shared_from_this());
+        }
+    }
+    else
+    {
+        startWaitingWritable(); // 这里一定要注册channel的写事件 否则Epoller不会给channel通知epollout
+    }
+}
+
+bool TcpConnection::waitingWritable() const
+{
+    return edgeTriggered_ ? writePending_ : channel_->isWriting();
+}
+
+void TcpConnection::startWaitingWritable()
+{
+    if (edgeTriggered_)
+    {
+        writePending_ = true;
+    }
+    else if (!channel_->isWriting())
+    {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::stopWaitingWritable()
+{
+    if (edgeTriggered_)
+    {
+        writePending_ = false;
+    }
+    else if (channel_->isWriting())
+    {
+        channel_->disableWriting();
+    }
+}
+
+void TcpConnection::send(const struct iovec *iov, int iovcnt)
+{
+    if (state_ == kConnected)
+    {
+        if (loop_->isInLoopThread())
+        {
+            sendvInLoop(iov, iovcnt);
+        }
+        else
+        {
+            // iov指向的内存在调用返回后就可能失效，只能拷贝一次
+            std::string message;
+            size_t total = 0;
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                total += iov[i].iov_len;
+            }
+            message.reserve(total);
+            for (int i = 0; i < iovcnt; ++i)
+            {
+                message.append(static_cast<const char *>(iov[i].iov_base), iov[i].iov_len);
+            }
+            send(std::move(message));
+        }
+    }
+}
+
+// 和sendInLoop的逻辑一样，只是直接发送时用writev，并且只把没有发出去的尾部拷贝进outputBuffer_
+void TcpConnection::sendvInLoop(const struct iovec *iov, int iovcnt)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "disconnected, give up writing";
+        return;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        total += iov[i].iov_len;
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    size_t nwrote = 0;
+    bool faultError = false;
+    if (!autoCork_ && !waitingWritable() && outputBuffer_.readableBytes() == 0)
+    {
+        ssize_t n = ::writev(channel_->fd(), iov, iovcnt);
+        if (n >= 0)
+        {
+            nwrote = n;
+            if (nwrote == total && writeCompleteCallback_)
+            {
+                queueWriteComplete();
+            }
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR << "TcpConnection::sendvInLoop";
+            if (errno == EPIPE || errno == ECONNRESET)
+            {
+                faultError = true;
+            }
+        }
+    }
+
+    if (!faultError && nwrote < total)
+    {
+        checkHighWaterMark(total - nwrote);
+        // 跳过已经写出去的nwrote字节，剩下的逐段拷贝
+        size_t skip = nwrote;
+        for (int i = 0; i < iovcnt; ++i)
         {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+            size_t len = iov[i].iov_len;
+            if (skip >= len)
+            {
+                skip -= len;
+                continue;
+            }
+            outputBuffer_.append(static_cast<const char *>(iov[i].iov_base) + skip, len - skip);
+            skip = 0;
         }
-        outputBuffer_.append((char *)data + nwrote, remaining);     // 将data中剩余还没有发送的数据最佳到buffer中
-        if (!channel_->isWriting())
+        scheduleWrite();
+    }
+}
+
+void TcpConnection::flushCorked()
+{
+    corked_ = false;
+    // 连接已经断开，或者已经注册了可写事件(剩下的数据由handleWrite继续发送)
+    if (state_ == kDisconnected || waitingWritable())
+    {
+        return;
+    }
+    flushOutput();
+}
+
+void TcpConnection::checkHighWaterMark(size_t len)
+{
+    size_t oldLen = outputBuffer_.readableBytes();  // 目前发送缓冲区剩余的待发送的数据的长度
+    // 判断待写数据是否会超过设置的高位标志highWaterMark_
+    if (oldLen + len >= highWaterMark_ && oldLen < highWaterMark_)
+    {
+        aboveHighWaterMark_ = true;
+        if (highWaterMarkCallback_)
         {
-            channel_->enableWriting(); // 这里一定要注册channel的写事件 否则Epoller不会给channel通知epollout
+            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + len));
         }
     }
+    // 越过硬上限时开始计时，宽限期过后还没有降下来就断开连接
+    if (outputHardLimit_ > 0 && !aboveHardLimit_ && oldLen + len > outputHardLimit_)
+    {
+        aboveHardLimit_ = true;
+        uint64_t seq = ++hardLimitSeq_;
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runAfter(outputGraceSeconds_, [weakConn, seq]() {
+            TcpConnectionPtr conn = weakConn.lock();
+            if (conn)
+            {
+                conn->checkOutputHardLimit(seq);
+            }
+        });
+    }
+}
+
+void TcpConnection::queueWriteComplete()
+{
+    // 任务只捕获连接本身，执行时再取回调；std::bind(writeCompleteCallback_, ...)要拷贝一次回调对象，
+    // 用户的回调捕获内容较多时std::function的拷贝会申请内存
+    TcpConnectionPtr conn(shared_from_this());
+    loop_->queueInLoop([conn]() {
+        if (conn->writeCompleteCallback_)
+        {
+            conn->writeCompleteCallback_(conn);
+        }
+    });
+}
+
+void TcpConnection::checkLowWaterMark()
+{
+    size_t len = outputBuffer_.readableBytes();
+    if (aboveHighWaterMark_ && len <= lowWaterMark_)
+    {
+        aboveHighWaterMark_ = false;
+        if (lowWaterMarkCallback_)
+        {
+            loop_->queueInLoop(std::bind(lowWaterMarkCallback_, shared_from_this(), len));
+        }
+    }
+    if (aboveHardLimit_ && len <= outputHardLimit_)
+    {
+        aboveHardLimit_ = false;
+    }
+}
+
+void TcpConnection::checkOutputHardLimit(uint64_t seq)
+{
+    // seq不同说明期间降到过硬上限以下，又重新开始计时了，由新的定时器处理
+    if (aboveHardLimit_ && seq == hardLimitSeq_ && state_ != kDisconnected)
+    {
+        LOG_WARN << "TcpConnection::checkOutputHardLimit [" << name_ << "] " << outputBuffer_.readableBytes()
+                 << " bytes queued for more than " << outputGraceSeconds_ << "s, dropping connection";
+        handleClose();
+    }
+}
+
+void TcpConnection::startRead()
+{
+    // 用户恢复读取时也认为积压的输入已经处理完了
+    resumeReading(kPauseByUser | kPauseByInput);
+}
+
+void TcpConnection::stopRead()
+{
+    pauseReading(kPauseByUser);
+}
+
+void TcpConnection::pauseReading(int reason)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::pauseReadingInLoop, shared_from_this(), reason));
+}
+
+void TcpConnection::resumeReading(int reason)
+{
+    loop_->runInLoop(std::bind(&TcpConnection::resumeReadingInLoop, shared_from_this(), reason));
+}
+
+void TcpConnection::pauseReadingInLoop(int reason)
+{
+    readPauseReasons_ |= reason;
+    if (reading_ && (state_ == kConnected || state_ == kDisconnecting))
+    {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
+void TcpConnection::resumeReadingInLoop(int reason)
+{
+    readPauseReasons_ &= ~reason;
+    if (readPauseReasons_ == 0 && !reading_ && (state_ == kConnected || state_ == kDisconnecting))
+    {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::bindBackpressure(const TcpConnectionPtr &source, const TcpConnectionPtr &sink,
+                                     size_t highWaterMark, size_t lowWaterMark)
+{
+    // 只持有source的弱引用，避免两个连接互相持有
+    std::weak_ptr<TcpConnection> weakSource(source);
+    // 回调只在sink的loop线程中读写
+    sink->getLoop()->runInLoop([sink, weakSource, highWaterMark, lowWaterMark]() {
+        sink->setHighWaterMarkCallback([weakSource](const TcpConnectionPtr &, size_t) {
+            TcpConnectionPtr src = weakSource.lock();
+            if (src) src->pauseReading(kPauseByPeer);
+        }, highWaterMark);
+        sink->setLowWaterMarkCallback([weakSource](const TcpConnectionPtr &, size_t) {
+            TcpConnectionPtr src = weakSource.lock();
+            if (src) src->resumeReading(kPauseByPeer);
+        }, lowWaterMark);
+    });
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t len)
+{
+    if (state_ == kConnected)
+    {
+        // 先在调用者线程中复制一份fd，这样即使调用者马上关闭了自己的fd，排队中的文件段依然有效
+        int fileFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (fileFd < 0)
+        {
+            LOG_ERROR << "TcpConnection::sendFile dup fd=" << fd << " failed";
+            return;
+        }
+        if (loop_->isInLoopThread())
+        {
+            sendFileInLoop(fileFd, offset, len);
+        }
+        else
+        {
+            loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, shared_from_this(), fileFd, offset, len));
+        }
+    }
+}
+
+/**
+ * 和sendInLoop的逻辑一样：outputBuffer_中没有排队的数据时直接sendfile，发不完的部分作为文件段
+ * 排到outputBuffer_的尾部，由handleWrite继续发送。fd的所有权在这里转交给outputBuffer_
+ */
+void TcpConnection::sendFileInLoop(int fd, off_t offset, size_t len)
+{
+    if (state_ == kDisconnected)
+    {
+        LOG_ERROR << "disconnected, give up sending file";
+        ::close(fd);
+        return;
+    }
+    // 长度为0时什么也不用发，当作一次已经完成的写
+    if (len == 0)
+    {
+        ::close(fd);
+        if (!waitingWritable() && outputBuffer_.readableBytes() == 0 && writeCompleteCallback_)
+        {
+            queueWriteComplete();
+        }
+        return;
+    }
+
+    size_t remaining = len;
+    bool faultError = false;
+    if (!waitingWritable() && outputBuffer_.readableBytes() == 0)
+    {
+        off_t off = offset;
+        ssize_t nwrote = ::sendfile(channel_->fd(), fd, &off, len);
+        if (nwrote > 0)
+        {
+            remaining = len - nwrote;
+            offset += nwrote;
+        }
+        else if (nwrote == 0)
+        {
+            LOG_ERROR << "TcpConnection::sendFileInLoop file is shorter than " << len << " bytes";
+            faultError = true;
+        }
+        else if (errno != EWOULDBLOCK)
+        {
+            LOG_ERROR << "TcpConnection::sendFileInLoop";
+            faultError = true;
+        }
+    }
+
+    if (faultError)
+    {
+        // 和handleWrite中一样：文件被截断或者连接出错，剩下的数据永远发不出去，对端也收不到完整的数据，只能关闭连接
+        ::close(fd);
+        handleClose();
+        return;
+    }
+    if (remaining == 0)
+    {
+        ::close(fd);
+        if (writeCompleteCallback_)
+        {
+            queueWriteComplete();
+        }
+        return;
+    }
+
+    checkHighWaterMark(remaining);
+    outputBuffer_.appendFile(fd, offset, remaining);
+    startWaitingWritable();
 }
 
 // 关闭连接 
@@ -185,9 +673,46 @@ void TcpConnection::shutdown()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseWithDelay(double seconds)
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        // 定时器只持有弱引用，连接在此之前正常关闭的话就什么也不做
+        std::weak_ptr<TcpConnection> weakConn(shared_from_this());
+        loop_->runAfter(seconds, [weakConn]() {
+            TcpConnectionPtr conn = weakConn.lock();
+            if (conn)
+            {
+                conn->forceClose();
+            }
+        });
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    // 期间连接可能已经因为对端关闭等原因被handleClose处理过了
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        handleClose();
+    }
+}
+
 void TcpConnection::shutdownInLoop()
 {
-    if (!channel_->isWriting()) // 说明当前outputBuffer_的数据全部向外发送完成
+    // 说明当前outputBuffer_的数据全部向外发送完成（auto-cork时没有注册可写事件也可能还有数据在排队，
+    // splice转发时管道中也可能还有数据）
+    if (!waitingWritable() && outputBuffer_.readableBytes() == 0 && (!spliceIn_ || spliceIn_->bytes == 0))
     {
         socket_->shutdownWrite();
     }
@@ -199,7 +724,12 @@ void TcpConnection::connectEstablished()
     setState(kConnected); // 建立连接，设置一开始状态为连接态
 
     channel_->tie(shared_from_this());
-    channel_->enableReading(); // 向Epoller注册channel的EPOLLIN读事件
+    channel_->enableReading(); // 向Epoller注册channel的EPOLLIN读事件(边沿触发时连同EPOLLOUT|EPOLLET一起注册)
+    if (idleWheel_)
+    {
+        idleEntry_.conn = this;
+        idleWheel_->add(&idleEntry_);
+    }
 
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
@@ -214,69 +744,390 @@ void TcpConnection::connectDestroyed()
         channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
         connectionCallback_(shared_from_this());
     }
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
     channel_->remove(); // 把channel从epoller中注销掉
 }
 
 void TcpConnection::handleRead(Timestamp receiveTime)
+{
+    if (spliceOut_)
+    {
+        spliceRead(receiveTime);
+        return;
+    }
+    bool drained = false;
+    if (!edgeTriggered_)
+    {
+        readOnce(receiveTime, &drained);
+        return;
+    }
+
+    // 边沿触发：socket中还有数据时不会再来可读事件，所以要一直读到读空为止。
+    // 读够edgeReadBudget_字节以后先让出loop，剩下的在本轮循环末尾接着读，其他连接不会被饿着
+    size_t total = 0;
+    for (;;)
+    {
+        ssize_t n = readOnce(receiveTime, &drained);
+        if (n <= 0 || drained)
+        {
+            return;
+        }
+        // 回调中暂停了读取(恢复时重新注册EPOLLIN，内核会再报告一次可读)或者关闭了连接
+        if (!reading_ || state_ == kDisconnected)
+        {
+            return;
+        }
+        total += n;
+        if (total >= edgeReadBudget_)
+        {
+            loop_->queueInLoop(std::bind(&TcpConnection::continueRead, shared_from_this()));
+            return;
+        }
+    }
+}
+
+ssize_t TcpConnection::readOnce(Timestamp receiveTime, bool *drained)
 {
     int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
+    // 按照预测的大小准备好inputBuffer_的可写空间，写不下的部分先进入loop的公共溢出区
+    inputBuffer_.ensureWritableBytes(readSizePredictor_.nextReadSize());
+    // readFd这一次最多读取的字节数：可写空间比溢出区小时两块都用上
+    const size_t writable = inputBuffer_.writableBytes();
+    const size_t requested = writable < EventLoop::kReadScratchSize ? writable + EventLoop::kReadScratchSize : writable;
+    ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno,
+                                    loop_->readScratch(), EventLoop::kReadScratchSize);
     if (n > 0)                      // 从fd读到了数据，并且放在了inputBuffer_上
     {
+        // 读到的比请求的少说明socket接收队列已经空了，之后再到达的数据会产生新的可读事件，不用再读一次等EAGAIN
+        *drained = static_cast<size_t>(n) < requested;
+        readSizePredictor_.record(n);
+        if (idleWheel_)
+        {
+            idleWheel_->touch(&idleEntry_);
+        }
         // 已建立连接的用户有可读事件发生了 调用用户传入的回调操作onMessage shared_from_this就是获取了TcpConnection的智能指针
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+        // 应用没有及时处理的数据越积越多，先停止读取，不再让对端的数据进入用户内存
+        if (inputBufferLimit_ > 0 && inputBuffer_.readableBytes() >= inputBufferLimit_ && reading_)
+        {
+            LOG_WARN << "TcpConnection::handleRead [" << name_ << "] input buffer reaches "
+                     << inputBuffer_.readableBytes() << " bytes, stop reading";
+            pauseReadingInLoop(kPauseByInput);
+        }
     }
     // n=0表示对方关闭了
     else if (n == 0) 
     {
         handleClose();
     }
+    else if (savedErrno == EAGAIN)
+    {
+        *drained = true;            // 已经读空(边沿触发时的正常结果)
+    }
     else // 出错了
     {
         errno = savedErrno;
         LOG_ERROR << "TcpConnection::handleRead() failed";
         handleError();
     }
+    return n;
+}
+
+void TcpConnection::handleHangup()
+{
+    // 边沿触发时暂停读取期间EPOLLOUT仍然注册着，两个方向都关闭以后会收到不带EPOLLIN的EPOLLHUP，
+    // 但接收队列中可能还有没读的数据(例如splice转发时下游积压)。先不关闭，恢复读取时重新注册EPOLLIN，
+    // 读完数据读到EOF再关闭。水平触发不能这样做，EPOLLHUP会在每次epoll_wait时一直报告
+    if (edgeTriggered_ && !reading_)
+    {
+        return;
+    }
+    handleClose();
+}
+
+void TcpConnection::continueRead()
+{
+    if (reading_ && (state_ == kConnected || state_ == kDisconnecting))
+    {
+        handleRead(Timestamp::now());
+    }
 }
 
 void TcpConnection::handleWrite()
 {
+    // 边沿触发时EPOLLOUT一直注册着，可读事件也会带上EPOLLOUT，没有等待发送的数据就什么也不做
+    if (edgeTriggered_ && !writePending_)
+    {
+        return;
+    }
     if (channel_->isWriting())
     {
-        int savedErrno = 0;
-        ssize_t n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+        flushOutput();
+        // 自己的outputBuffer_发完了，再发送对端splice过来的数据
+        if (spliceIn_ && outputBuffer_.readableBytes() == 0)
+        {
+            spliceWrite();
+        }
+    }
+    else
+    {
+        LOG_ERROR << "TcpConnection fd=" << channel_->fd() << " is down, no more writing";
+    }
+}
+
+void TcpConnection::startSplice(const TcpConnectionPtr &peer,
+                                const std::shared_ptr<SplicePipe> &out,
+                                const std::shared_ptr<SplicePipe> &in)
+{
+    splicePeer_ = peer;
+    spliceOut_ = out;
+    spliceIn_ = in;
+    // 已经读进inputBuffer_但还没有处理的数据先交给对端，对端会在发送管道中的数据之前把它们发出去
+    if (inputBuffer_.readableBytes() > 0)
+    {
+        peer->send(&inputBuffer_);
+    }
+}
+
+void TcpConnection::spliceRead(Timestamp receiveTime)
+{
+    SplicePipe *out = spliceOut_.get();
+    TcpConnectionPtr peer = splicePeer_.lock();
+    if (!peer || peer->disconnected())
+    {
+        // 对端已经关闭，读到的数据没有地方可去了
+        handleClose();
+        return;
+    }
+
+    for (;;)
+    {
+        if (out->bytes >= out->capacity)
+        {
+            pauseReadingInLoop(kPauseByPeer);
+            return;
+        }
+        ssize_t n = ::splice(channel_->fd(), NULL, out->writeFd, NULL, out->capacity - out->bytes,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
         if (n > 0)
         {
-            outputBuffer_.retrieve(n);          // 把outputBuffer_的readerIndex往前移动n个字节，因为outputBuffer_中readableBytes已经发送出去了n字节
-            if (outputBuffer_.readableBytes() == 0)
+            out->bytes += n;
+            if (idleWheel_)
             {
-                channel_->disableWriting();     //数据发送完毕后注销写事件，以免epoll频繁触发可写事件，导致效力低下
-                if (writeCompleteCallback_)
-                {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
-                }
-                if (state_ == kDisconnecting)
-                {
-                    shutdownInLoop();           // 关闭写端，而非直接关闭连接，是为了保证已经发送除去的数据客户端还能够完整接收
-                }
+                idleWheel_->touch(&idleEntry_);
+            }
+            peer->spliceWrite();
+            // 对端发不出去，管道积压满了，暂停读取，等对端把管道排空以后再恢复
+            if (out->bytes >= out->capacity)
+            {
+                pauseReadingInLoop(kPauseByPeer);
+                return;
+            }
+            // 水平触发时socket中剩下的数据会再次触发EPOLLIN；边沿触发时要一直读到EAGAIN(管道容量限制了一次读取的总量)
+            if (!edgeTriggered_ || !reading_ || state_ == kDisconnected)
+            {
+                return;
+            }
+            continue;
+        }
+        else if (n == 0)
+        {
+            // 上游半关闭：对端把管道中剩下的数据发完以后关闭写端，另一个方向继续转发，
+            // 两个方向都结束以后才关闭连接
+            out->eof = true;
+            pauseReadingInLoop(kPauseByEof);
+            peer->spliceWrite();
+            // spliceIn_为空说明另一个方向已经结束(对端发完以后也可能已经连带关闭了本端)
+            if (state_ != kDisconnected && !spliceIn_)
+            {
+                handleClose();
             }
         }
+        else if (errno == EAGAIN)
+        {
+            // 管道中的数据不足一页时也会占用一整个pipe buffer，管道可能在bytes到达capacity之前就满了，
+            // 这时socket仍然可读，不暂停的话会一直触发EPOLLIN
+            if (out->bytes > 0)
+            {
+                pauseReadingInLoop(kPauseByPeer);
+            }
+        }
+        else if ((errno == EINVAL || errno == ENOSYS) && out->bytes == 0)
+        {
+            LOG_WARN << "TcpConnection::spliceRead [" << name_ << "] splice not supported, falls back to buffer copy";
+            stopSpliceRead();
+            handleRead(receiveTime);
+        }
         else
         {
-            LOG_ERROR << "TcpConnection::handleWrite() failed";
+            LOG_ERROR << "TcpConnection::spliceRead [" << name_ << "] failed, errno=" << errno;
+            handleClose();
         }
+        return;
     }
-    else
+}
+
+void TcpConnection::spliceWrite()
+{
+    if (!spliceIn_ || state_ == kDisconnected)
     {
-        LOG_ERROR << "TcpConnection fd=" << channel_->fd() << " is down, no more writing";
+        return;
+    }
+    // 先把自己outputBuffer_中排队的数据发完，保证顺序
+    if (outputBuffer_.readableBytes() > 0)
+    {
+        if (edgeTriggered_ && !waitingWritable())
+        {
+            // 边沿触发时socket可能一直可写，不会再来可写事件，先自己写一次，写不完flushOutput会等待可写
+            flushOutput();
+        }
+        else
+        {
+            startWaitingWritable();
+        }
+        if (outputBuffer_.readableBytes() > 0)
+        {
+            return;
+        }
+    }
+
+    SplicePipe *in = spliceIn_.get();
+    while (in->bytes > 0)
+    {
+        ssize_t n = ::splice(in->readFd, NULL, channel_->fd(), NULL, in->bytes,
+                             SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0)
+        {
+            in->bytes -= n;
+        }
+        else if (n < 0 && errno == EAGAIN)
+        {
+            break;
+        }
+        else
+        {
+            LOG_ERROR << "TcpConnection::spliceWrite [" << name_ << "] failed, errno=" << errno;
+            handleClose();
+            return;
+        }
+    }
+
+    if (in->bytes > 0)
+    {
+        // socket发送缓冲区满了，剩下的留在管道中，等可写事件
+        startWaitingWritable();
+        return;
+    }
+
+    stopWaitingWritable();
+    if (in->eof || state_ == kDisconnecting)
+    {
+        // 上游已经关闭(或者调用过shutdown)并且数据都发完了，关闭写端，这个方向的转发结束
+        spliceIn_.reset();
+        if (state_ == kConnected)
+        {
+            setState(kDisconnecting);
+        }
+        shutdownInLoop();
+        // 本端的上游也已经读完，两个方向都结束了
+        if (spliceOut_ && spliceOut_->eof)
+        {
+            handleClose();
+        }
+        return;
+    }
+    // 管道排空了，上游可以继续读
+    TcpConnectionPtr source = splicePeer_.lock();
+    if (source)
+    {
+        source->resumeReadingInLoop(kPauseByPeer);
     }
 }
 
+void TcpConnection::stopSpliceRead()
+{
+    // 之后读到的数据进入inputBuffer_，由messageCallback_(TcpRelay设置的转发函数)交给对端
+    spliceOut_.reset();
+}
+
+void TcpConnection::flushOutput()
+{
+    if (outputBuffer_.readableBytes() == 0)
+    {
+        return;
+    }
+    int savedErrno = 0;
+    ssize_t n = 0;
+    if (zeroCopy_)
+    {
+        DataHolder pinned;
+        n = outputBuffer_.writeFdZeroCopy(channel_->fd(), &savedErrno, zeroCopyThreshold_, &pinned);
+        if (pinned)
+        {
+            pinZeroCopy(pinned);
+        }
+    }
+    else
+    {
+        n = outputBuffer_.writeFd(channel_->fd(), &savedErrno);
+    }
+    if (n > 0)
+    {
+        outputBuffer_.retrieve(n);          // 把outputBuffer_的readerIndex往前移动n个字节，因为outputBuffer_中readableBytes已经发送出去了n字节
+        checkLowWaterMark();
+        if (outputBuffer_.readableBytes() == 0)
+        {
+            stopWaitingWritable(); //数据发送完毕后注销写事件，以免epoll频繁触发可写事件，导致效力低下
+            if (writeCompleteCallback_)
+            {
+                queueWriteComplete();
+            }
+            if (state_ == kDisconnecting)
+            {
+                shutdownInLoop();           // 关闭写端，而非直接关闭连接，是为了保证已经发送除去的数据客户端还能够完整接收
+            }
+        }
+        else
+        {
+            startWaitingWritable();         // auto-cork的flush没有一次写完，剩下的等可写事件
+        }
+    }
+    else if (n < 0 && savedErrno == EWOULDBLOCK)
+    {
+        startWaitingWritable();
+    }
+    else
+    {
+        LOG_ERROR << "TcpConnection::handleWrite() failed";
+        // 排队的文件被截断了，剩下的数据永远发不出去，对端也收不到完整的数据，只能关闭连接
+        if (savedErrno == EIO)
+        {
+            handleClose();
+        }
+    }
+}
 
 void TcpConnection::handleClose()
 {
     setState(kDisconnected);
     channel_->disableAll();
+    if (idleWheel_)
+    {
+        idleWheel_->remove(&idleEntry_);
+    }
+    // splice转发：通知对端上游已经关闭，对端发完管道中的数据后关闭写端
+    if (spliceOut_)
+    {
+        spliceOut_->eof = true;
+        TcpConnectionPtr peer = splicePeer_.lock();
+        if (peer)
+        {
+            peer->spliceWrite();
+        }
+    }
     TcpConnectionPtr connPtr(shared_from_this());
     connectionCallback_(connPtr); // 执行连接关闭的回调(用户自定的，而且和新连接到来时执行的是同一个回调)
     closeCallback_(connPtr);      // 执行关闭连接的回调 执行的是TcpServer::removeConnection回调方法   // must be the last line
@@ -284,6 +1135,12 @@ void TcpConnection::handleClose()
 
 void TcpConnection::handleError()
 {
+    // 零拷贝的完成通知也是通过EPOLLERR报告的，这时socket本身并没有出错
+    if (!zeroCopyPending_.empty())
+    {
+        handleZeroCopyCompletions();
+    }
+
     int optval;
     socklen_t optlen = sizeof(optval);
     int err = 0;
@@ -296,5 +1153,86 @@ void TcpConnection::handleError()
     {
         err = optval;
     }
-    LOG_ERROR << "TcpConnection::handleError name:" << name_.c_str() << " - SO_ERROR:" << err;
+    if (err != 0)
+    {
+        LOG_ERROR << "TcpConnection::handleError name:" << name_.c_str() << " - SO_ERROR:" << err;
+    }
+}
+
+void TcpConnection::setZeroCopy(bool on, size_t threshold)
+{
+    zeroCopyThreshold_ = threshold;
+    if (on == zeroCopy_)
+    {
+        return;
+    }
+    // 关闭时不需要清除SO_ZEROCOPY，之后不再带MSG_ZEROCOPY发送即可，已经发出的通知照常处理
+    zeroCopy_ = on ? socket_->setZeroCopy(true) : false;
+}
+
+bool TcpConnection::setSocketBusyPoll(int usec)
+{
+    return socket_->setBusyPoll(usec);
+}
+
+void TcpConnection::setEdgeTriggered(size_t readBudget)
+{
+    edgeTriggered_ = true;
+    edgeReadBudget_ = readBudget;
+    channel_->setEdgeTriggered();
+}
+
+void TcpConnection::pinZeroCopy(const DataHolder &holder)
+{
+    zeroCopyPending_.push_back(ZeroCopySend{zeroCopyNextId_++, holder, false});
+}
+
+void TcpConnection::handleZeroCopyCompletions()
+{
+    char control[128];
+    for (;;)
+    {
+        struct msghdr msg;
+        ::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        // 错误队列读空时返回EAGAIN
+        if (::recvmsg(channel_->fd(), &msg, MSG_ERRQUEUE) < 0)
+        {
+            break;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR)
+            {
+                continue;
+            }
+            const struct sock_extended_err *serr = reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+            if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || zeroCopyPending_.empty())
+            {
+                continue;
+            }
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                // 内核最终还是拷贝了数据(例如发往本机回环地址，或者网卡不支持scatter-gather)
+                LOG_DEBUG << "TcpConnection::handleZeroCopyCompletions [" << name_ << "] kernel fell back to copying";
+            }
+
+            // 通知不保证按顺序到达，先标记区间[lo, hi]内的发送，再从队首释放连续完成的数据
+            const uint32_t base = zeroCopyPending_.front().id;
+            for (uint32_t id = serr->ee_info; static_cast<int32_t>(id - serr->ee_data) <= 0; ++id)
+            {
+                uint32_t index = id - base;
+                if (index < zeroCopyPending_.size())
+                {
+                    zeroCopyPending_[index].done = true;
+                }
+            }
+            while (!zeroCopyPending_.empty() && zeroCopyPending_.front().done)
+            {
+                zeroCopyPending_.pop_front();
+            }
+        }
+    }
 }
\ No newline at end of file
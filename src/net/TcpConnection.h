@@ -3,15 +3,22 @@
 #include "noncopyable.h"
 #include "Callback.h"
 #include "Buffer.h"
+#include "ChainBuffer.h"
+#include "ReadSizePredictor.h"
+#include "SendList.h"
+#include "TimingWheel.h"
 #include "Timestamp.h"
 #include "InetAddress.h"
 
 #include <atomic>
 #include <any>
+#include <deque>
+#include <stdint.h>
 
 class Channel;
 class EventLoop;
 class Socket;
+struct SplicePipe;
 
 
 class TcpConnection : noncopyable, public std::enable_shared_from_this<TcpConnection>
@@ -33,10 +40,49 @@ public:
 
     // 发送数据
     void send(const std::string &buf);
+    // 接管message的存储空间，跨线程和排队时都不拷贝数据
+    void send(std::string &&message);
+    // buf中的数据被取走。跨线程时通过swap把整块存储移交给loop线程，调用返回后buf为空
     void send(Buffer *buf);
+    void send(Buffer &&buf) { send(&buf); }
+    // 多段数据一次writev发送：在loop线程中先直接writev，只有没发完的部分才拷贝进outputBuffer_；
+    // 跨线程调用时各段被拷贝到一个payload中再交给loop线程
+    void send(const struct iovec *iov, int iovcnt);
+    void send(const SendList &list) { send(list.iov(), list.count()); }
+    // 发送一份共享的只读数据：发不完的部分只引用payload而不拷贝，同一个payload可以同时发给很多连接
+    void send(const PayloadPtr &payload);
+    // 发送文件fd中从offset开始的len字节，数据由sendfile在内核中直接拷贝到socket，不经过用户内存。
+    // 函数内部会dup一份fd，调用返回后调用者就可以关闭自己的fd。与之前send()的数据保持先后顺序
+    void sendFile(int fd, off_t offset, size_t len);
 
-    // 关闭连接
+    // 关闭连接：outputBuffer_中的数据发送完以后关闭写端(半关闭)
     void shutdown();
+    // 不等待数据发送完，直接关闭连接，可以在任意线程调用
+    void forceClose();
+    // seconds秒后强制关闭连接(期间不再接受新的send)，给对端留出读取剩余数据的时间
+    void forceCloseWithDelay(double seconds);
+    bool disconnected() const { return state_ == kDisconnected; }
+
+    /**
+     * 开启/关闭MSG_ZEROCOPY发送，需要在连接所属的loop线程中调用（例如在ConnectionCallback中）。
+     * 只对send(const PayloadPtr&)、send(std::string&&)以及跨线程移交的Buffer中不少于threshold字节的数据生效：
+     * 内核直接引用这些数据的内存，数据会被连接一直持有，直到错误队列上收到内核的完成通知。小数据的页锁定和通知开销比拷贝还大，所以有阈值
+     */
+    void setZeroCopy(bool on, size_t threshold = 64 * 1024);
+    bool zeroCopy() const { return zeroCopy_; }
+
+    // 设置socket的SO_BUSY_POLL(见Socket::setBusyPoll)，一般配合EventLoop::setBusyPoll使用
+    bool setSocketBusyPoll(int usec);
+
+    /**
+     * auto-cork：开启后send不再立即write，数据先追加到outputBuffer_，一轮事件循环结束时(doPendingFunctors之后)
+     * 由EventLoop统一调用flushCorked，用一次writev发出去。一个消息分多次send(头部、消息体...)时
+     * 可以减少系统调用和小TCP报文。需要在连接所属的loop线程中调用，或者通过TcpServer::setAutoCork统一开启
+     */
+    void setAutoCork(bool on) { autoCork_ = on; }
+    bool autoCork() const { return autoCork_; }
+    // 由EventLoop调用，发送本轮积攒的数据
+    void flushCorked();
 
     void setContext(const std::any& context)
     { context_ = context; }
@@ -55,8 +101,51 @@ public:
     { closeCallback_ = cb; }
     void setHighWaterMarkCallback(const HighWaterMarkCallback &cb, size_t highWaterMark)
     { highWaterMarkCallback_ = cb; highWaterMark_ = highWaterMark; }
+    // outputBuffer_越过高水位线之后，又降到lowWaterMark以下时回调一次(通常用来恢复上游的读取)
+    void setLowWaterMarkCallback(const LowWaterMarkCallback &cb, size_t lowWaterMark)
+    { lowWaterMarkCallback_ = cb; lowWaterMark_ = lowWaterMark; }
+
+    /**
+     * 流量控制
+     * stopRead/startRead：暂停/恢复从socket读取数据（注销/注册EPOLLIN），可以在任意线程调用。
+     * 暂停读取的原因有三种，只有所有原因都解除了才会恢复读取：用户调用stopRead、inputBuffer_超过上限、下游连接积压
+     */
+    void startRead();
+    void stopRead();
+    bool isReading() const { return reading_; }
+
+    // inputBuffer_中积压的数据在messageCallback之后仍不少于limit字节时暂停读取(0表示不限制)。
+    // 应用处理完积压的数据后调用startRead()恢复
+    void setInputBufferLimit(size_t limit) { inputBufferLimit_ = limit; }
+
+    // outputBuffer_超过limit字节并且持续graceSeconds秒都没有降下来时，认为对端已经无法及时接收，直接断开连接(0表示不限制)
+    void setOutputHardLimit(size_t limit, double graceSeconds)
+    { outputHardLimit_ = limit; outputGraceSeconds_ = graceSeconds; }
+
+    /**
+     * 把source的读取和sink的发送队列绑定起来(例如代理中把客户端连接绑定到后端连接)：
+     * sink的outputBuffer_超过highWaterMark时暂停source的读取，降到lowWaterMark以下时恢复。
+     * 会覆盖sink上已经设置的高/低水位回调，source和sink可以属于不同的loop
+     */
+    static void bindBackpressure(const TcpConnectionPtr &source, const TcpConnectionPtr &sink,
+                                 size_t highWaterMark, size_t lowWaterMark);
     
+    /**
+     * 边沿触发模式(TcpServer::setEdgeTriggered)，在connectEstablished之前设置：
+     * 读事件到来时一直读到socket读空(EAGAIN或者读到的比请求的少)，但是一次最多读readBudget字节，
+     * 超过以后把剩下的读取排到本轮循环的末尾，不让一个连接占满整个loop；
+     * 可写事件一直注册着，发送积压开始和结束时不再调用epoll_ctl
+     */
+    void setEdgeTriggered(size_t readBudget);
+    bool edgeTriggered() const { return edgeTriggered_; }
+
     // TcpServer会调用
+    // 加入所属loop的空闲连接时间轮(TcpServer::setIdleTimeout)，在connectEstablished之前设置
+    void setIdleWheel(const std::shared_ptr<TimingWheel> &wheel) { idleWheel_ = wheel; }
+    // TcpRelay调用：之后从socket读到的数据splice进out，由peer发送；peer读到的数据在in中，由本连接发送
+    void startSplice(const TcpConnectionPtr &peer,
+                     const std::shared_ptr<SplicePipe> &out,
+                     const std::shared_ptr<SplicePipe> &in);
     void connectEstablished();                      // 连接建立
     void connectDestroyed();                        // 连接销毁
 
@@ -71,23 +160,83 @@ private:
 
     void setState(StateE state) { state_ = state; }
 
+    // 暂停读取的原因，readPauseReasons_中的位
+    enum ReadPauseReason
+    {
+        kPauseByUser = 1,
+        kPauseByInput = 2,
+        kPauseByPeer = 4,
+        kPauseByEof = 8,        // splice转发时上游已经半关闭，不再恢复读取
+    };
+    // 可以在任意线程调用，实际的修改在loop线程中进行
+    void pauseReading(int reason);
+    void resumeReading(int reason);
+    void pauseReadingInLoop(int reason);
+    void resumeReadingInLoop(int reason);
+
     // 注册到channel上有事件发生时，其回调函数就是绑定的下面这些函数
     void handleRead(Timestamp receiveTime);
+    // 从socket读一次并交给messageCallback_，drained返回socket是否已经读空
+    ssize_t readOnce(Timestamp receiveTime, bool *drained);
+    // 边沿触发时上一次读取用完了预算，在本轮循环末尾接着读
+    void continueRead();
     void handleWrite();
     void handleClose();
+    // channel上的EPOLLHUP
+    void handleHangup();
     void handleError();
 
     // 在自己所属的loop中发送数据
-    void sendInLoop(const void* message, size_t len);
+    // owner不为空时，message指向owner中的数据，没发完的部分以引用的方式排队，不拷贝
+    void sendInLoop(const void* message, size_t len, const DataHolder& owner = DataHolder());
     void sendInLoop(const std::string& message);
+    // 没发完的部分把message整个移进outputBuffer_(字符串段)，不拷贝也不申请内存
+    void sendStringInLoop(std::string &&message);
+    // outputBuffer_中没有排队的数据(并且没有开启auto-cork)时直接发送，返回发送出去的字节数，
+    // 连接已经出错(EPIPE/ECONNRESET)时*faultError为true
+    size_t writeDirect(const void *data, size_t len, const DataHolder &owner, bool *faultError);
+    void sendPayloadInLoop(const PayloadPtr& payload);
+    void sendBufferInLoop(const std::shared_ptr<Buffer>& buf);
+    void sendvInLoop(const struct iovec *iov, int iovcnt);
+    // 数据已经进入outputBuffer_，安排发送：开启auto-cork时登记到loop等本轮结束时flush，否则注册可写事件
+    void scheduleWrite();
+    // 是否有数据在等待可写事件。水平触发时就是channel是否注册了EPOLLOUT，边沿触发时EPOLLOUT一直注册着，只改writePending_
+    bool waitingWritable() const;
+    void startWaitingWritable();
+    void stopWaitingWritable();
+    // 发送完成，在下一轮循环中调用writeCompleteCallback_
+    void queueWriteComplete();
+    void sendFileInLoop(int fd, off_t offset, size_t len);
+    // 把outputBuffer_中的数据写到socket，写完了注销可写事件，写不完则注册可写事件
+    void flushOutput();
+    // 有len字节将要进入outputBuffer_，判断是否会越过高水位线以及硬上限
+    void checkHighWaterMark(size_t len);
+    // outputBuffer_中的数据被发送出去以后，判断是否降到了低水位线/硬上限以下
+    void checkLowWaterMark();
+    // 超过硬上限graceSeconds秒之后由定时器调用，seq用来判断这期间是否曾经降到硬上限以下
+    void checkOutputHardLimit(uint64_t seq);
+    // splice转发：从socket读到spliceOut_，以及把spliceIn_中的数据写到socket
+    void spliceRead(Timestamp receiveTime);
+    void spliceWrite();
+    // splice出错(例如这种socket不支持splice)时，这个方向退回到Buffer路径
+    void stopSpliceRead();
     // 在自己所属的loop中关闭连接
     void shutdownInLoop();
+    void forceCloseInLoop();
+    // 记录一次MSG_ZEROCOPY发送，数据的所有者保留到内核通知完成
+    void pinZeroCopy(const DataHolder &holder);
+    // 读取错误队列上的零拷贝完成通知，释放已经完成的数据
+    void handleZeroCopyCompletions();
 
 
     EventLoop *loop_;                               // 属于哪个subLoop（如果是单线程则为baseLoop）
     const std::string name_;
     std::atomic_int state_;                         // 连接状态
-    bool reading_;
+    bool reading_;                                  // 当前是否在读取(channel是否注册了EPOLLIN)
+    int readPauseReasons_;                          // 暂停读取的原因(ReadPauseReason按位或)
+    bool edgeTriggered_;                            // channel以边沿触发方式注册
+    size_t edgeReadBudget_;                         // 边沿触发时一次可读事件最多读取的字节数
+    bool writePending_;                             // 边沿触发时outputBuffer_中有数据在等待可写事件
 
     std::unique_ptr<Socket> socket_;                // 把fd封装成socket，这样便于socket析构时自动关闭fd
     std::unique_ptr<Channel> channel_;              // fd对应的channel
@@ -105,9 +254,40 @@ private:
     CloseCallback closeCallback_;                   // 客户端关闭连接的回调
     HighWaterMarkCallback highWaterMarkCallback_;   // 超出水位实现的回调
     size_t highWaterMark_;
+    LowWaterMarkCallback lowWaterMarkCallback_;     // 越过高水位线后又回落到低水位线的回调
+    size_t lowWaterMark_;
+    bool aboveHighWaterMark_;                       // outputBuffer_越过了高水位线，还没有回落到低水位线
+
+    size_t inputBufferLimit_;                       // inputBuffer_的上限，超过则暂停读取
+    size_t outputHardLimit_;                        // outputBuffer_的硬上限，持续超过则断开连接
+    double outputGraceSeconds_;
+    bool aboveHardLimit_;
+    uint64_t hardLimitSeq_;                         // 每次越过硬上限时加一，定时器据此判断是否一直没有降下来
 
     Buffer inputBuffer_;                            // 读取数据的缓冲区
-    Buffer outputBuffer_;                           // 发送数据的缓冲区
+    ReadSizePredictor readSizePredictor_;           // 预测下一次read的大小，提前给inputBuffer_准备好可写空间
+    ChainBuffer outputBuffer_;                      // 发送数据的缓冲区（slab链表，扩容时不会搬动已缓存的数据）
+
+    // 零拷贝发送的状态：内核给每次成功的MSG_ZEROCOPY发送依次编号，完成通知给出一个编号区间[lo, hi]
+    struct ZeroCopySend
+    {
+        uint32_t id;
+        DataHolder holder;
+        bool done;
+    };
+    bool autoCork_;
+    bool corked_;                                   // 已经在loop的dirtyConnections_中，等待本轮结束时flush
+    bool zeroCopy_;
+    size_t zeroCopyThreshold_;
+    uint32_t zeroCopyNextId_;                       // 下一次零拷贝发送的编号
+    std::deque<ZeroCopySend> zeroCopyPending_;      // 内核还在引用的数据，编号连续递增
+
+    std::weak_ptr<TcpConnection> splicePeer_;       // TcpRelay绑定的对端连接
+    std::shared_ptr<SplicePipe> spliceOut_;         // 本连接读到的数据 -> 对端
+    std::shared_ptr<SplicePipe> spliceIn_;          // 对端读到的数据 -> 本连接
+
+    std::shared_ptr<TimingWheel> idleWheel_;        // 空闲连接检测的时间轮，没有开启时为空
+    TimingWheel::Entry idleEntry_;                  // 挂在idleWheel_上的节点
 
-    std::any context_;                              // 用户自定义数据(这里主要用于存储时间轮的WeakEntryPtr)
+    std::any context_;                              // 用户自定义数据
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "TcpRelay.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+const int SplicePipe::kPipeSize;
+const size_t TcpRelay::kHighWaterMark;
+const size_t TcpRelay::kLowWaterMark;
+
+SplicePipe::SplicePipe()
+    : readFd(-1)
+    , writeFd(-1)
+    , capacity(0)
+    , bytes(0)
+    , eof(false)
+{
+    int fds[2];
+    if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        LOG_ERROR << "SplicePipe pipe2 failed, errno=" << errno;
+        return;
+    }
+    readFd = fds[0];
+    writeFd = fds[1];
+    ::fcntl(writeFd, F_SETPIPE_SZ, kPipeSize);
+    int size = ::fcntl(writeFd, F_GETPIPE_SZ);
+    capacity = size > 0 ? static_cast<size_t>(size) : 64 * 1024;
+}
+
+SplicePipe::~SplicePipe()
+{
+    if (readFd >= 0)
+    {
+        ::close(readFd);
+        ::close(writeFd);
+    }
+}
+
+// Buffer路径：收到的数据直接交给对端发送
+static void forwardTo(const std::weak_ptr<TcpConnection> &weakPeer,
+                      const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    TcpConnectionPtr peer = weakPeer.lock();
+    if (peer)
+    {
+        peer->send(buf);
+    }
+    else
+    {
+        buf->retrieveAll();
+    }
+}
+
+bool TcpRelay::bind(const TcpConnectionPtr &a, const TcpConnectionPtr &b)
+{
+    // 先设置好Buffer路径的回调，splice中途失败时也会退回到这条路径
+    a->setMessageCallback(std::bind(&forwardTo, std::weak_ptr<TcpConnection>(b),
+                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    b->setMessageCallback(std::bind(&forwardTo, std::weak_ptr<TcpConnection>(a),
+                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+
+    if (a->getLoop() == b->getLoop())
+    {
+        std::shared_ptr<SplicePipe> aToB = std::make_shared<SplicePipe>();
+        std::shared_ptr<SplicePipe> bToA = std::make_shared<SplicePipe>();
+        if (aToB->valid() && bToA->valid())
+        {
+            a->startSplice(b, aToB, bToA);
+            b->startSplice(a, bToA, aToB);
+            return true;
+        }
+    }
+
+    LOG_INFO << "TcpRelay::bind " << a->name() << " <-> " << b->name() << " falls back to buffer copy";
+    TcpConnection::bindBackpressure(a, b, kHighWaterMark, kLowWaterMark);
+    TcpConnection::bindBackpressure(b, a, kHighWaterMark, kLowWaterMark);
+    return false;
+}
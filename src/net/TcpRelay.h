@@ -0,0 +1,46 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callback.h"
+
+#include <stddef.h>
+
+/**
+ * splice使用的管道，一个方向一个：上游连接把socket中的数据splice进来，下游连接再从这里splice到自己的socket，
+ * 数据始终留在内核中。管道的容量就是这个方向上允许积压的数据量，写满了就暂停上游的读取
+ */
+struct SplicePipe : noncopyable
+{
+    static const int kPipeSize = 256 * 1024;       // 尝试把管道扩大到256KB，失败则保持系统默认的64KB
+
+    SplicePipe();
+    ~SplicePipe();
+
+    bool valid() const { return readFd >= 0; }
+
+    int readFd;
+    int writeFd;
+    size_t capacity;        // 管道的实际容量
+    size_t bytes;           // 管道中还没有发送给下游的字节数
+    bool eof;               // 上游已经关闭，管道排空以后下游关闭写端
+};
+
+/**
+ * 在两个已建立的连接之间双向转发数据(TCP代理)。
+ * 两个连接属于同一个loop时，数据通过splice(2)在socket和管道之间移动，不经过inputBuffer_/outputBuffer_，
+ * 下游socket不可写时管道会积压，积压满了就暂停上游的读取。一端半关闭时，对端发完管道中的数据后关闭写端，
+ * 另一个方向继续转发，两个方向都结束以后两个连接才关闭。
+ * 两个连接属于不同的loop或者无法创建管道时，退回到Buffer路径：messageCallback中把数据send给对端，
+ * 并用bindBackpressure做流量控制，此时一端关闭后需要由使用者在ConnectionCallback中shutdown另一端。
+ */
+class TcpRelay
+{
+public:
+    // 需要在a所属的loop线程中调用(例如ConnectionCallback中)，使用splice时返回true。
+    // 会覆盖两个连接的MessageCallback以及高/低水位回调
+    static bool bind(const TcpConnectionPtr &a, const TcpConnectionPtr &b);
+
+    // Buffer路径时的高/低水位
+    static const size_t kHighWaterMark = 1024 * 1024;
+    static const size_t kLowWaterMark = 256 * 1024;
+};
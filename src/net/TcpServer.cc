@@ -1,6 +1,8 @@
 
 #include "TcpServer.h"
 
+#include <future>
+
 // 检查传入的 baseLoop 指针是否有意义
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -16,16 +18,30 @@ TcpServer::TcpServer(EventLoop *loop,
                      const std::string &nameArg,
                      Option option)
     : loop_(CheckLoopNotNull(loop))
+    , listenAddr_(listenAddr)
     , ipPort_(listenAddr.toIpPort())
     , name_(nameArg)
     , acceptor_(new Acceptor(loop, listenAddr, option == kReusePort))
+    , acceptPerLoop_(false)
+    , backlog_(Acceptor::kDefaultBacklog)
+    , deferAcceptSeconds_(0)
+    , fastOpenQueue_(0)
+    , maxAcceptsPerEvent_(Acceptor::kDefaultMaxAcceptsPerEvent)
+    , idleSeconds_(0)
     , threadPool_(new EventLoopThreadPool(loop, name_))
     , connectionCallback_(defaultConnectionCallback)
     , messageCallback_(defaultMessageCallback)
     , writeCompleteCallback_()
     , threadInitCallback_()
     , started_(0)
+    , stopping_(false)
     , nextConnId_(1)    
+    , autoCork_(false)
+    , edgeTriggered_(false)
+    , edgeReadBudget_(kDefaultEdgeReadBudget)
+    , busyPollUs_(0)
+    , socketBusyPollUs_(0)
+    , loopStats_(false)
 {
     // 当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生执行handleRead()调用TcpServer::newConnection回调
     acceptor_->setNewConnectionCallback(
@@ -34,7 +50,35 @@ TcpServer::TcpServer(EventLoop *loop,
 
 TcpServer::~TcpServer()
 {
-    for(auto &item : connections_)
+    // subLoop的Acceptor要在自己的loop线程中注销channel，等它们析构完，之后不会再有回调进入TcpServer。
+    // subLoop已经退出时EventLoop也已经销毁，回调不会再执行：不等待，让Acceptor脱离loop以后直接在这里析构
+    for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        // 回调没有执行就随EventLoop析构而被释放时promise也被释放，future得到broken_promise，不会一直等下去
+        auto done = std::make_shared<std::promise<void>>();
+        std::future<void> destroyed = done->get_future();
+        bool queued = threadPool_->runInLoopIfRunning(acceptor->getLoop(), [&acceptor, done]() {
+            acceptor.reset();
+            done->set_value();
+        });
+        if (queued)
+        {
+            destroyed.wait();
+        }
+        if (acceptor)
+        {
+            acceptor->detachLoop();
+            acceptor.reset();
+        }
+    }
+
+    // subLoop可能正在removeConnection，持有mutex_把连接表换出来再逐个销毁
+    ConnectionMap connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for(auto &item : connections)
     {
         TcpConnectionPtr conn(item.second);
         // 把原始的智能指针复位 让栈空间的TcpConnectionPtr conn指向该对象 当conn出了其作用域 即可释放智能指针指向的对象
@@ -45,9 +89,9 @@ TcpServer::~TcpServer()
 }
 
 // 设置底层subloop的个数
-void TcpServer::setThreadNum(int numThreads)
+void TcpServer::setThreadNum(int numThreads, const ThreadPlacement &placement)
 {
-    threadPool_->setThreadNum(numThreads);
+    threadPool_->setThreadNum(numThreads, placement);
 }
 
 void TcpServer::start()
@@ -56,21 +100,78 @@ void TcpServer::start()
     {
         // 启动底层的lopp线程池
         threadPool_->start(threadInitCallback_);
+        if (busyPollUs_ > 0)
+        {
+            int spinUs = busyPollUs_;
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                ioLoop->runInLoop([ioLoop, spinUs]() { ioLoop->setBusyPoll(spinUs); });
+            }
+        }
+        if (loopStats_)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                ioLoop->setStatsEnabled(true);
+            }
+        }
+        if (idleSeconds_ > 0)
+        {
+            for (EventLoop *ioLoop : threadPool_->getAllLoops())
+            {
+                std::shared_ptr<TimingWheel> wheel = std::make_shared<TimingWheel>(ioLoop, idleSeconds_);
+                idleWheels_.push_back(wheel);
+                // 定时器只持有弱引用，TcpServer析构以后baseLoop上的定时器什么也不做
+                std::weak_ptr<TimingWheel> weakWheel(wheel);
+                ioLoop->runEvery(1.0, [weakWheel]() {
+                    std::shared_ptr<TimingWheel> w = weakWheel.lock();
+                    if (w) w->tick();
+                });
+            }
+        }
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        if (acceptPerLoop_ && loops[0] != loop_)
+        {
+            // baseLoop不再accept，每个subLoop监听自己的socket
+            acceptor_.reset();
+            for (EventLoop *ioLoop : loops)
+            {
+                std::unique_ptr<Acceptor> acceptor(new Acceptor(ioLoop, listenAddr_, true));
+                configureAcceptor(acceptor.get());
+                acceptor->setNewConnectionCallback(
+                    std::bind(&TcpServer::newConnectionInLoop, this, ioLoop, std::placeholders::_1, std::placeholders::_2));
+                ioLoop->runInLoop(std::bind(&Acceptor::listen, acceptor.get()));
+                loopAcceptors_.push_back(std::move(acceptor));
+            }
+            return;
+        }
+        configureAcceptor(acceptor_.get());
         // acceptor_.get()绑定时候需要地址
         loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
     }
 }
 
+void TcpServer::configureAcceptor(Acceptor *acceptor)
+{
+    acceptor->setBacklog(backlog_);
+    acceptor->setDeferAccept(deferAcceptSeconds_);
+    acceptor->setFastOpen(fastOpenQueue_);
+    acceptor->setMaxAcceptsPerEvent(maxAcceptsPerEvent_);
+}
+
 // 有一个新用户连接，acceptor会执行这个回调操作，负责将mainLoop接收到的请求连接(acceptChannel_会有读事件发生)通过回调轮询分发给subLoop去处理
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     // 轮询算法 选择一个subLoop 来管理connfd对应的channel
-    EventLoop *ioLoop = threadPool_->getNextLoop();
+    newConnectionInLoop(threadPool_->getNextLoop(), sockfd, peerAddr);
+}
+
+void TcpServer::newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr)
+{
     // 提示信息
     char buf[64] = {0};
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    // 这里没有设置为原子类是因为其只在mainloop中执行 不涉及线程安全问题
-    ++nextConnId_;  
+    // 每个subLoop都可能在建立连接(setAcceptPerLoop)，所以编号是原子的
+    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_++);
     // 新连接名字
     std::string connName = name_ + buf;
 
@@ -87,28 +188,173 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 
     InetAddress localAddr(local);
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
-    connections_[connName] = conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 已经在stop：subLoop的Acceptor还没来得及关闭时又accept到的连接，直接关闭(conn析构时关闭fd)
+        if (stopping_)
+        {
+            return;
+        }
+        connections_[connName] = conn;
+    }
     // 下面的回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setAutoCork(autoCork_);
+    if (edgeTriggered_ && ioLoop->supportsEdgeTriggered())
+    {
+        conn->setEdgeTriggered(edgeReadBudget_);
+    }
+    if (socketBusyPollUs_ > 0)
+    {
+        conn->setSocketBusyPoll(socketBusyPollUs_);
+    }
+    for (const std::shared_ptr<TimingWheel> &wheel : idleWheels_)
+    {
+        if (wheel->getLoop() == ioLoop)
+        {
+            conn->setIdleWheel(wheel);
+            break;
+        }
+    }
 
     // 设置了如何关闭连接的回调
     conn->setCloseCallback(std::bind(&TcpServer::removeConnection, this, std::placeholders::_1));
 
+    // 在ioLoop线程中(setAcceptPerLoop)直接建立连接，否则投递给ioLoop
     ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
 }
 
-void TcpServer::removeConnection(const TcpConnectionPtr &conn)
+void TcpServer::stop(double drainTimeout, const StoppedCallback &stoppedCallback)
+{
+    loop_->runInLoop(std::bind(&TcpServer::stopInLoop, this, drainTimeout, stoppedCallback));
+}
+
+void TcpServer::stopInLoop(double drainTimeout, const StoppedCallback &stoppedCallback)
+{
+    std::vector<TcpConnectionPtr> conns;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+        {
+            return;
+        }
+        stopping_ = true;
+        conns.reserve(connections_.size());
+        for (auto &item : connections_)
+        {
+            conns.push_back(item.second);
+        }
+    }
+    stoppedCallback_ = stoppedCallback;
+
+    // 析构Acceptor会把监听socket从poller中移除并关闭，之后不会再有新连接
+    acceptor_.reset();
+    // subLoop的Acceptor在各自的loop线程中析构
+    for (std::unique_ptr<Acceptor> &acceptor : loopAcceptors_)
+    {
+        EventLoop *ioLoop = acceptor->getLoop();
+        ioLoop->runInLoop([acceptor = std::move(acceptor)]() mutable { acceptor.reset(); });
+    }
+    loopAcceptors_.clear();
+    LOG_INFO << "TcpServer::stop [" << name_ << "] draining " << conns.size() << " connections";
+
+    // 在连接自己的loop中关闭：刚accept的连接还是kConnecting，connectEstablished还排在它的loop中，
+    // 投递的任务排在其后执行，这时连接已经是kConnected；状态也只在loop线程中修改
+    for (const TcpConnectionPtr &conn : conns)
+    {
+        conn->getLoop()->runInLoop([conn, drainTimeout]() {
+            conn->shutdown();
+            conn->forceCloseWithDelay(drainTimeout);
+        });
+    }
+
+    if (conns.empty())
+    {
+        finishStopInLoop();
+    }
+}
+
+void TcpServer::finishStopInLoop()
 {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    LOG_INFO << "TcpServer::stop [" << name_ << "] all connections closed";
+    if (!stoppedCallback_)
+    {
+        return;
+    }
+    // 各个subLoop中可能还排着connectDestroyed，往每个subLoop投递一个任务，它们都执行完以后
+    // 所有连接的channel都已经注销、fd都已经关闭，这时再通知用户(用户通常会接着退出baseLoop、析构TcpServer)
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    auto remaining = std::make_shared<std::atomic_int>(static_cast<int>(loops.size()));
+    for (EventLoop *ioLoop : loops)
+    {
+        ioLoop->queueInLoop([this, remaining]() {
+            if (--*remaining == 0)
+            {
+                loop_->queueInLoop(stoppedCallback_);
+            }
+        });
+    }
 }
 
-void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
+void TcpServer::removeConnection(const TcpConnectionPtr &conn)
 {
-    LOG_INFO << "TcpServer::removeConnectionInLoop [" << name_.c_str() << "] - connection " << conn->name().c_str();
+    // 在连接所属的subLoop中调用，connections_由mutex_保护，不需要再转到baseLoop
+    LOG_INFO << "TcpServer::removeConnection [" << name_.c_str() << "] - connection " << conn->name().c_str();
 
-    connections_.erase(conn->name());
+    bool stopped = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections_.erase(conn->name());
+        stopped = stopping_ && connections_.empty();
+    }
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+
+    if (stopped)
+    {
+        loop_->runInLoop(std::bind(&TcpServer::finishStopInLoop, this));
+    }
+}
+
+void TcpServer::broadcast(const PayloadPtr &payload)
+{
+    loop_->runInLoop(std::bind(&TcpServer::broadcastInLoop, this, payload));
+}
+
+void TcpServer::broadcastInLoop(const PayloadPtr &payload)
+{
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    std::vector<std::vector<TcpConnectionPtr>> groups(loops.size());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &item : connections_)
+        {
+            EventLoop *ioLoop = item.second->getLoop();
+            for (size_t i = 0; i < loops.size(); ++i)
+            {
+                if (loops[i] == ioLoop)
+                {
+                    groups[i].push_back(item.second);
+                    break;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < loops.size(); ++i)
+    {
+        if (groups[i].empty())
+        {
+            continue;
+        }
+        // 在subLoop中直接调用send，payload剩余没发完的部分只是被各个连接引用
+        loops[i]->runInLoop([conns = std::move(groups[i]), payload]() {
+            for (const TcpConnectionPtr &conn : conns)
+            {
+                conn->send(payload);
+            }
+        });
+    }
+}
@@ -8,7 +8,10 @@
 #include "Callback.h"
 #include "TcpConnection.h"
 
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 
 class TcpServer
 {
@@ -21,6 +24,8 @@ public:
         kReusePort,
     };
 
+    static const size_t kDefaultEdgeReadBudget = 256 * 1024;
+
 
     TcpServer(EventLoop *loop,
                 const InetAddress &ListenAddr,
@@ -34,11 +39,74 @@ public:
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
 
-    // 设置底层subLoop的个数
-    void setThreadNum(int numThreads);
+    // 新连接是否开启auto-cork(见TcpConnection::setAutoCork)，在start之前设置
+    void setAutoCork(bool on) { autoCork_ = on; }
+
+    // 开启空闲连接检测：连续seconds秒没有收到数据的连接被强制关闭，在start之前设置。
+    // 每个subLoop有一个自己的时间轮(见TimingWheel)，不占用TcpConnection的context
+    void setIdleTimeout(int seconds) { idleSeconds_ = seconds; }
+
+    // 所有subLoop开启busy-poll(见EventLoop::setBusyPoll)，socketBusyPollUs大于0时新连接还会设置SO_BUSY_POLL。
+    // 在start之前设置
+    void setBusyPoll(int maxSpinUs, int socketBusyPollUs = 0)
+    {
+        busyPollUs_ = maxSpinUs;
+        socketBusyPollUs_ = socketBusyPollUs;
+    }
+
+    /**
+     * 新连接使用边沿触发(见TcpConnection::setEdgeTriggered)，readBudget是一次可读事件最多读取的字节数。
+     * 只有epoll支持，subLoop使用io_uring时仍然是水平触发。在start之前设置
+     */
+    void setEdgeTriggered(bool on, size_t readBudget = kDefaultEdgeReadBudget)
+    {
+        edgeTriggered_ = on;
+        edgeReadBudget_ = readBudget;
+    }
+
+    /**
+     * 每个subLoop各自监听listenAddr(SO_REUSEPORT)并在本线程中建立连接，不再由baseLoop accept以后
+     * 通过runInLoop分发，连接风暴时baseLoop不会成为瓶颈，每个新连接也少一次跨线程唤醒。
+     * 连接在各个subLoop之间的分配由内核按照四元组的哈希决定。没有subLoop(setThreadNum(0))时不起作用。在start之前设置
+     */
+    void setAcceptPerLoop(bool on) { acceptPerLoop_ = on; }
+
+    /**
+     * 监听socket的选项(见Acceptor)，在start之前设置，setAcceptPerLoop时对每个subLoop的监听socket都生效
+     * backlog：等待accept的连接队列长度，默认1024
+     * deferAcceptSeconds：TCP_DEFER_ACCEPT，客户端发来数据以后才accept，0表示不开启
+     * fastOpenQueue：TCP_FASTOPEN的队列长度，0表示不开启
+     * maxAcceptsPerEvent：一次可读事件最多accept的连接数，默认64
+     */
+    void setListenBacklog(int backlog) { backlog_ = backlog; }
+    void setDeferAccept(int seconds) { deferAcceptSeconds_ = seconds; }
+    void setFastOpen(int queueLen) { fastOpenQueue_ = queueLen; }
+    void setMaxAcceptsPerEvent(int n) { maxAcceptsPerEvent_ = n; }
+
+    // 所有ioLoops()开启运行统计(见EventLoopStats)，在start之前设置
+    void setLoopStats(bool on) { loopStats_ = on; }
+    // 处理连接的loop：所有subLoop，没有subLoop时是baseLoop。start以后可以在任意线程中读取它们的stats()
+    std::vector<EventLoop*> ioLoops() { return threadPool_->getAllLoops(); }
+
+    // subLoop使用的IO复用实现(见Poller)，在start之前设置
+    void setPollerType(Poller::Type type) { threadPool_->setPollerType(type); }
+
+    // 设置底层subLoop的个数，placement决定subLoop线程的CPU亲和性和调度策略(见ThreadPlacement)，
+    // 例如ThreadPlacement::onePerCore(true)：每个subLoop独占一个物理核，并且避开0号核
+    void setThreadNum(int numThreads, const ThreadPlacement &placement = ThreadPlacement());
 
     // 开启服务器
     void start();
+
+    /**
+     * 停止服务器，可以在任意线程调用：
+     * 1. 关闭监听socket，不再接受新连接
+     * 2. 对所有连接调用shutdown()，已经进入发送队列的响应发送完后关闭写端
+     * 3. drainTimeout秒后仍未关闭的连接被强制关闭
+     * 所有连接都关闭以后在baseLoop中调用stoppedCallback(例如在其中quit baseLoop)
+     */
+    using StoppedCallback = std::function<void()>;
+    void stop(double drainTimeout, const StoppedCallback &stoppedCallback = StoppedCallback());
     
     EventLoop* getLoop() const { return loop_; }
 
@@ -46,20 +114,41 @@ public:
 
     const std::string ipPort() { return ipPort_; }
 
+    // 把同一份payload发送给当前所有的连接，可以在任意线程调用。
+    // 连接按所属的subLoop分组，每个subLoop只投递一个任务，所有连接共享这一份数据，不会为每个连接拷贝
+    void broadcast(const PayloadPtr &payload);
+
 private:
     using ConnectionMap = std::unordered_map<std::string, TcpConnectionPtr>;
 
     // 新连接到来时的处理函数（acceptor_可读时绑定的回调函数）
     void newConnection(int sockfd, const InetAddress &peerAddr);
+    // 把监听socket的选项设置到acceptor上
+    void configureAcceptor(Acceptor *acceptor);
+    // 创建ioLoop上的连接，在ioLoop线程中调用时直接建立连接
+    void newConnectionInLoop(EventLoop *ioLoop, int sockfd, const InetAddress &peerAddr);
 
     void removeConnection(const TcpConnectionPtr &conn);
 
-    void removeConnectionInLoop(const TcpConnectionPtr &conn);
+    void stopInLoop(double drainTimeout, const StoppedCallback &stoppedCallback);
+    // 所有连接都已经从connections_中移除
+    void finishStopInLoop();
+
+    void broadcastInLoop(const PayloadPtr &payload);
 
     EventLoop *loop_;                               // 用户定义的mainLoop
+    const InetAddress listenAddr_;
     const std::string ipPort_;                      // 传入的IP地址和端口号
     const std::string name_;                        // TcpServer名字
     std::unique_ptr<Acceptor> acceptor_;            // 用于监听和接收新连接的Acceptor
+    bool acceptPerLoop_;
+    std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;  // setAcceptPerLoop时每个subLoop一个Acceptor
+    int backlog_;
+    int deferAcceptSeconds_;
+    int fastOpenQueue_;
+    int maxAcceptsPerEvent_;
+    int idleSeconds_;                               // 空闲超时时间，0表示不检测
+    std::vector<std::shared_ptr<TimingWheel>> idleWheels_;  // 每个subLoop一个时间轮
     std::shared_ptr<EventLoopThreadPool> threadPool_;  
     ConnectionCallback connectionCallback_;
     MessageCallback messageCallback_;               // 有读写消息时的回调函数
@@ -68,7 +157,17 @@ private:
     ThreadInitCallback threadInitCallback_;         // loop线程初始化的回调函数
     std::atomic_int started_;                
 
-    int nextConnId_;            
+    bool stopping_;                                 // 调用过stop，正在等待连接全部关闭
+    StoppedCallback stoppedCallback_;
+
+    std::atomic_int nextConnId_;
+    bool autoCork_;
+    bool edgeTriggered_;                            // 新连接使用边沿触发
+    size_t edgeReadBudget_;
+    int busyPollUs_;                                // subLoop的最大自旋时长，0表示不开启busy-poll
+    int socketBusyPollUs_;                          // 新连接的SO_BUSY_POLL，0表示不设置
+    bool loopStats_;                                // subLoop是否开启运行统计
+    std::mutex mutex_;                              // 保护connections_和stopping_，每个subLoop都可能建立、移除连接
     ConnectionMap connections_;                     // 保存所有的连接
 };
 
@@ -2,7 +2,7 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
-#include  <functional>
+#include "InlineFunction.h"
 
 /**
  * 定时器类：一个定时器应该需要知道超时时间，是否重复，如果是重复的定时器就需要知道执行间隔是多少，
@@ -12,7 +12,7 @@
 class Timer : noncopyable
 {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = InlineFunction<void()>;
 
     Timer(TimerCallback cb, Timestamp when, double interval)
         : callback_(std::move(cb))
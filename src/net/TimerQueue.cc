@@ -55,6 +55,8 @@ void readTimerfd(int timerfd)
 }
 
 
+// 看门狗报告卡在定时器回调中时显示的名字
+static const std::string kTimerChannelName("TimerQueue");
 
 TimerQueue::TimerQueue(EventLoop *loop)
     : loop_(loop)
@@ -64,6 +66,7 @@ TimerQueue::TimerQueue(EventLoop *loop)
 {
     // 为timerfd的可读事件设置回调函数并向epoll中注册timerfd的可读事件
     timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
+    timerfdChannel_.setName(&kTimerChannelName);
     timerfdChannel_.enableReading();
 }
 
@@ -120,6 +123,16 @@ void TimerQueue::handleRead()
 
     // 获取超时的定时器并挨个调用定时器的回调函数
     std::vector<Entry> expired = getExpired(now);
+    EventLoopStats &stats = loop_->stats();
+    if (stats.enabled())
+    {
+        // 定时器比预定时刻晚了多久才执行
+        for (const Entry& it : expired)
+        {
+            int64_t lateUs = now.microSecondsSinceEpoch() - it.first.microSecondsSinceEpoch();
+            stats.timerLateness().record(lateUs > 0 ? static_cast<uint64_t>(lateUs) * 1000 : 0);
+        }
+    }
     callingExpiredTimers_ = true;
     for (const Entry& it : expired)
     {
@@ -11,7 +11,7 @@ class Timer;
 class TimerQueue
 {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = InlineFunction<void()>;
     explicit TimerQueue(EventLoop *loop);
     ~TimerQueue();
 
@@ -0,0 +1,103 @@
+#include "TimingWheel.h"
+#include "TcpConnection.h"
+#include "Logging.h"
+
+TimingWheel::TimingWheel(EventLoop *loop, int timeoutSeconds)
+    : loop_(loop)
+    , timeout_(timeoutSeconds)
+    , now_(0)
+    , buckets_(timeoutSeconds + 1)
+{
+    // 哨兵自己指向自己表示空桶。buckets_之后不会再扩容，哨兵的地址是稳定的
+    for (Entry &head : buckets_)
+    {
+        head.prev = &head;
+        head.next = &head;
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+    // 还挂着的连接只是从时间轮中摘下来，连接本身由TcpServer负责关闭
+    for (Entry &head : buckets_)
+    {
+        while (head.next != &head)
+        {
+            unlink(head.next);
+        }
+    }
+}
+
+void TimingWheel::link(Entry *head, Entry *entry)
+{
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+void TimingWheel::unlink(Entry *entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = nullptr;
+    entry->next = nullptr;
+}
+
+void TimingWheel::add(Entry *entry)
+{
+    if (entry->linked())
+    {
+        return;
+    }
+    entry->lastActive = now_;
+    link(&buckets_[(now_ + timeout_) % buckets_.size()], entry);
+}
+
+void TimingWheel::remove(Entry *entry)
+{
+    if (entry->linked())
+    {
+        unlink(entry);
+    }
+}
+
+void TimingWheel::tick()
+{
+    ++now_;
+    Entry &head = buckets_[now_ % buckets_.size()];
+    if (head.next == &head)
+    {
+        return;
+    }
+    // 先把整个桶摘下来再逐个处理，还活跃的连接会被挂到其他桶中
+    Entry *entry = head.next;
+    head.prev->next = nullptr;
+    head.prev = &head;
+    head.next = &head;
+
+    std::vector<TcpConnectionPtr> expired;
+    while (entry != nullptr)
+    {
+        Entry *next = entry->next;
+        int64_t deadline = entry->lastActive + timeout_;
+        if (deadline > now_)
+        {
+            // deadline - now_ <= timeout_ < 桶的个数，不会挂回当前桶
+            link(&buckets_[deadline % buckets_.size()], entry);
+        }
+        else
+        {
+            entry->prev = nullptr;
+            entry->next = nullptr;
+            expired.push_back(entry->conn->shared_from_this());
+        }
+        entry = next;
+    }
+
+    for (const TcpConnectionPtr &conn : expired)
+    {
+        LOG_INFO << "TimingWheel::tick connection " << conn->name() << " idle for " << timeout_ << "s, closing";
+        conn->forceClose();
+    }
+}
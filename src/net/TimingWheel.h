@@ -0,0 +1,56 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <vector>
+#include <stdint.h>
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 踢掉空闲连接的时间轮，每个loop一个，只在所属loop的线程中使用(TcpServer::setIdleTimeout)
+ *
+ * 时间轮有timeout+1个桶，每秒tick一次，当前指针移到哪个桶，就检查这个桶里的连接。
+ * 连接通过内嵌在TcpConnection中的Entry(侵入式双向链表节点)挂在桶上，收到数据时只是把当前的
+ * tick写进entry->lastActive(touch)，不移动节点，也不需要shared_ptr/weak_ptr。
+ * tick检查到一个节点时才根据lastActive决定：还没到期就挂到它真正到期的那个桶(延迟重新分桶)，
+ * 已经到期就强制关闭这个连接。
+ */
+class TimingWheel : noncopyable
+{
+public:
+    struct Entry
+    {
+        Entry() : conn(nullptr), prev(nullptr), next(nullptr), lastActive(0) {}
+
+        TcpConnection *conn;
+        Entry *prev;
+        Entry *next;
+        int64_t lastActive;         // 最近一次收到数据时的tick
+        bool linked() const { return next != nullptr; }
+    };
+
+    TimingWheel(EventLoop *loop, int timeoutSeconds);
+    ~TimingWheel();
+
+    EventLoop* getLoop() const { return loop_; }
+
+    // 连接建立时加入时间轮，连接关闭时移除，都是O(1)
+    void add(Entry *entry);
+    void remove(Entry *entry);
+    // 连接上有活动，O(1)，只有一次写操作
+    void touch(Entry *entry) { entry->lastActive = now_; }
+
+    // 每秒调用一次：处理当前桶中的连接，关闭到期的连接
+    void tick();
+
+private:
+    static void link(Entry *head, Entry *entry);
+    static void unlink(Entry *entry);
+
+    EventLoop *loop_;
+    const int timeout_;
+    int64_t now_;                   // 当前的tick
+    std::vector<Entry> buckets_;    // 每个桶是一个带哨兵的循环链表，哨兵就是这里的元素
+};